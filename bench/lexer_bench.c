@@ -0,0 +1,88 @@
+#define _POSIX_C_SOURCE 199309L
+#include <ether/ether.h>
+#include <time.h>
+
+/* measures lexer throughput.
+ * usage: lexer_bench [file] [copies] [iterations]
+ * the input file is repeated 'copies' times in memory. lines starting
+ * with the old '#' comment syntax are rewritten to ';;' comments so
+ * that res/big_test_file.eth lexes without errors. */
+
+static char* make_input(char*, u64, u64*);
+static double lex_seconds(SourceFile*);
+static double best_lex_seconds(SourceFile*, uint);
+
+int main(int argc, char** argv) {
+	char* fpath = argc > 1 ? argv[1] : "res/big_test_file.eth";
+	u64 copies = argc > 2 ? strtoull(argv[2], null, 10) : 64;
+	uint iterations = argc > 3 ? (uint)strtoul(argv[3], null, 10) : 5;
+
+	SourceFile file;
+	file.fpath = fpath;
+	file.contents = make_input(fpath, copies, &file.len);
+	file.map_len = 0;
+	file.line_offsets = null;
+	const double mb = (double)file.len / (1024.0 * 1024.0);
+	printf("input: %s x %lu (%.1f MB)\n", fpath, copies, mb);
+
+	double best = best_lex_seconds(&file, iterations);
+	printf("lexer %8.1f MB/s  (%.3fs)\n", mb / best, best);
+
+	free(file.contents);
+	return 0;
+}
+
+static char* make_input(char* fpath, u64 copies, u64* out_len) {
+	SourceFile* src = ether_read_file(fpath);
+	if (!src) {
+		ether_error("%s: no such file or directory", fpath);
+	}
+
+	char* one = (char*)malloc(src->len + 1);
+	memcpy(one, src->contents, src->len);
+	for (u64 i = 0; i < src->len; ++i) {
+		if (one[i] == '#' && (i == 0 || one[i-1] == '\n')) {
+			one[i] = ';';
+			if (i + 1 < src->len && one[i+1] == ' ') one[i+1] = ';';
+		}
+	}
+
+	u64 len = src->len * copies;
+	char* contents = (char*)malloc(len + 1);
+	for (u64 i = 0; i < copies; ++i) {
+		memcpy(contents + i * src->len, one, src->len);
+	}
+	contents[len] = '\0';
+
+	free(one);
+	ether_close_file(src);
+	*out_len = len;
+	return contents;
+}
+
+static double best_lex_seconds(SourceFile* file, uint iterations) {
+	lex_seconds(file); /* warm up the intern table and page cache */
+	double best = 0.0;
+	for (uint i = 0; i < iterations; ++i) {
+		double t = lex_seconds(file);
+		if (i == 0 || t < best) best = t;
+	}
+	return best;
+}
+
+static double lex_seconds(SourceFile* file) {
+	struct timespec start, end;
+	error_code err = false;
+	Lexer lexer;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	TokenStore* tokens = lexer_run(&lexer, file, &err);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (err == ETHER_ERROR) {
+		ether_error("lexing failed; benchmark input must lex cleanly.");
+	}
+	token_store_free(tokens);
+	return (double)(end.tv_sec - start.tv_sec) +
+		   (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+}
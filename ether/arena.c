@@ -0,0 +1,61 @@
+#include <ether/ether.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+/* bump allocator; memory is handed out zeroed and only ever released
+ * all at once by arena_free */
+void* arena_alloc(Arena* arena, u64 size) {
+	size = (size + ARENA_ALIGNMENT - 1) & ~(u64)(ARENA_ALIGNMENT - 1);
+	if ((u64)(arena->end - arena->ptr) < size) {
+		u64 block_size = MAX(size, ARENA_BLOCK_SIZE);
+		char* block = (char*)malloc(block_size);
+		assert(block);
+		buf_push(arena->blocks, block);
+		arena->ptr = block;
+		arena->end = block + block_size;
+	}
+
+	void* ptr = arena->ptr;
+	arena->ptr += size;
+	memset(ptr, 0, size);
+	return ptr;
+}
+
+/* a zeroed stretchy buffer of 'len' elements living in the arena;
+ * it can be read with the buf_* macros but never grown or freed */
+void* arena_buf_alloc(Arena* arena, u64 len, u64 elem_size) {
+	if (len == 0) return null;
+
+	BufHdr* hdr = (BufHdr*)arena_alloc(arena, offsetof(BufHdr, buf) +
+									   len * elem_size);
+	hdr->len = len;
+	hdr->cap = len;
+	return hdr->buf;
+}
+
+/* copies 'len' elements into a buffer made by arena_buf_alloc */
+void* arena_buf_copy(Arena* arena, const void* elems, u64 len, u64 elem_size) {
+	void* buf = arena_buf_alloc(arena, len, elem_size);
+	if (buf) memcpy(buf, elems, len * elem_size);
+	return buf;
+}
+
+/* hands all of 'other's memory over to 'arena'; 'other' is left empty */
+void arena_merge(Arena* arena, Arena* other) {
+	for (u64 i = 0; i < buf_len(other->blocks); ++i) {
+		buf_push(arena->blocks, other->blocks[i]);
+	}
+	buf_free(other->blocks);
+	other->ptr = null;
+	other->end = null;
+}
+
+void arena_free(Arena* arena) {
+	for (u64 i = 0; i < buf_len(arena->blocks); ++i) {
+		free(arena->blocks[i]);
+	}
+	buf_free(arena->blocks);
+	arena->ptr = null;
+	arena->end = null;
+}
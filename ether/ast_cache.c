@@ -0,0 +1,365 @@
+#define _DEFAULT_SOURCE
+#include <ether/ether.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define AST_CACHE_MAGIC "ETHAST\0\0"
+#define AST_CACHE_ALIGNMENT 16
+
+/* a cache file is a header followed by one section per FlatAst pool.
+ * every section starts with a BufHdr, so once the file is mapped the
+ * pools can be read in place with the buf_* macros, just like the
+ * arena's buffers. tokens are stored without pointers: the lexeme is
+ * the index of a string in the string section, where every distinct
+ * lexeme is stored once, and the source file is the one the cache
+ * belongs to. the file is only used if the compiler that wrote it is
+ * this one and the hash and length of the source match, and then only
+ * if its tree passes flat_ast_check; anything else is a miss and the
+ * module is parsed. */
+
+typedef enum {
+	SECTION_STMTS,
+	SECTION_EXPRS,
+	SECTION_DATA_TYPES,
+	SECTION_FIELDS,
+	SECTION_BRANCHES,
+	SECTION_LISTS,
+	SECTION_TOKENS,
+	SECTION_LOADS,
+	SECTION_STRINGS,
+	SECTION_COUNT,
+} CacheSection;
+
+typedef struct {
+	u32 lexeme; /* index of the string, FLAT_NONE for null */
+	u32 line;
+	u32 column;
+	u8 type;
+	u8 keyword;
+} CachedToken;
+
+typedef struct {
+	char magic[8];
+	u32 version;
+	u32 elem_sizes[SECTION_COUNT];
+	u64 build;
+	u64 hash;
+	u64 src_len;
+	FlatRange top_level;
+	u64 sections[SECTION_COUNT]; /* file offsets of the BufHdrs */
+} CacheHeader;
+
+static const u32 elem_sizes[SECTION_COUNT] = {
+	[SECTION_STMTS] = sizeof(FlatStmt),
+	[SECTION_EXPRS] = sizeof(FlatExpr),
+	[SECTION_DATA_TYPES] = sizeof(FlatDataType),
+	[SECTION_FIELDS] = sizeof(FlatField),
+	[SECTION_BRANCHES] = sizeof(FlatIfBranch),
+	[SECTION_LISTS] = sizeof(u32),
+	[SECTION_TOKENS] = sizeof(CachedToken),
+	[SECTION_LOADS] = sizeof(CachedToken),
+	[SECTION_STRINGS] = sizeof(char),
+};
+
+static u64 build_id(void);
+static u64 hash_bytes(u64, void*, u64);
+static char* cache_path(char*, u64);
+static void* read_section(SourceFile*, CacheHeader*, CacheSection);
+static char** read_strings(char*);
+static bool tokens_valid(CachedToken*, char**, SourceFile*);
+static bool position_valid(SourceFile*, u32, u32);
+static Token read_token(CachedToken*, char**, SourceFile*);
+static void write_section(char**, CacheHeader*, CacheSection, void*, u64);
+static CachedToken write_token(Token*, char**, Map*);
+
+/* false if there is no usable cache for 'file', in which case it has
+ * to be parsed */
+bool ast_cache_read(char* cache_dir, SourceFile* file, u64 hash, Arena* arena,
+					Stmt*** out_stmts, Token*** out_loads) {
+	char* fpath = cache_path(cache_dir, hash);
+	SourceFile* cache = ether_read_file(fpath);
+	buf_free(fpath);
+	if (!cache) return false;
+
+	bool ok = false;
+	CacheHeader* header = (CacheHeader*)cache->contents;
+	if (cache->len >= sizeof(CacheHeader) &&
+		memcmp(header->magic, AST_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+		header->version == AST_CACHE_VERSION &&
+		memcmp(header->elem_sizes, elem_sizes, sizeof(elem_sizes)) == 0 &&
+		header->build == build_id() &&
+		header->hash == hash && header->src_len == file->len) {
+		void* sections[SECTION_COUNT] = { 0 };
+		ok = true;
+		for (uint i = 0; i < SECTION_COUNT && ok; ++i) {
+			sections[i] = read_section(cache, header, (CacheSection)i);
+			if (sections[i] == cache) ok = false;
+		}
+
+		FlatAst ast;
+		char** strings = null;
+		CachedToken* tokens = (CachedToken*)sections[SECTION_TOKENS];
+		CachedToken* loads = (CachedToken*)sections[SECTION_LOADS];
+		if (ok) {
+			strings = read_strings((char*)sections[SECTION_STRINGS]);
+			ok = tokens_valid(tokens, strings, file) &&
+				 tokens_valid(loads, strings, file);
+			/* a load's lexeme is the path */
+			for (u64 i = 0; i < buf_len(loads) && ok; ++i) {
+				ok = loads[i].lexeme != FLAT_NONE;
+			}
+		}
+
+		if (ok) {
+			ast.stmts = (FlatStmt*)sections[SECTION_STMTS];
+			ast.exprs = (FlatExpr*)sections[SECTION_EXPRS];
+			ast.data_types = (FlatDataType*)sections[SECTION_DATA_TYPES];
+			ast.fields = (FlatField*)sections[SECTION_FIELDS];
+			ast.branches = (FlatIfBranch*)sections[SECTION_BRANCHES];
+			ast.lists = (u32*)sections[SECTION_LISTS];
+			ast.tokens = (Token*)arena_buf_alloc(arena, buf_len(tokens), sizeof(Token));
+			ast.top_level = header->top_level;
+			for (u64 i = 0; i < buf_len(tokens); ++i) {
+				ast.tokens[i] = read_token(&tokens[i], strings, file);
+			}
+			ok = flat_ast_check(&ast);
+		}
+
+		if (ok) {
+			*out_stmts = flat_ast_expand(&ast, arena);
+
+			*out_loads = null;
+			for (u64 i = 0; i < buf_len(loads); ++i) {
+				Token* t = (Token*)arena_alloc(arena, sizeof(Token));
+				*t = read_token(&loads[i], strings, file);
+				buf_push(*out_loads, t);
+			}
+		}
+		buf_free(strings);
+	}
+
+	ether_close_file(cache);
+	return ok;
+}
+
+/* the file is written next to its final name and renamed into place,
+ * so a compiler running at the same time never sees half of it */
+error_code ast_cache_write(char* cache_dir, SourceFile* file, u64 hash,
+						   FlatAst* ast, Token** loads) {
+	/* lines are stored in 32 bits */
+	if (file->len >= FLAT_NONE) return ETHER_ERROR;
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(CacheHeader));
+	memcpy(header.magic, AST_CACHE_MAGIC, sizeof(header.magic));
+	header.version = AST_CACHE_VERSION;
+	memcpy(header.elem_sizes, elem_sizes, sizeof(elem_sizes));
+	header.build = build_id();
+	header.hash = hash;
+	header.src_len = file->len;
+	header.top_level = ast->top_level;
+
+	char* strings = null;
+	Map string_indices = { 0 };
+	CachedToken* tokens = null;
+	CachedToken* cached_loads = null;
+	for (u64 i = 0; i < buf_len(ast->tokens); ++i) {
+		buf_push(tokens, write_token(&ast->tokens[i], &strings, &string_indices));
+	}
+	for (u64 i = 0; i < buf_len(loads); ++i) {
+		buf_push(cached_loads, write_token(loads[i], &strings, &string_indices));
+	}
+
+	char* out = null;
+	buf_fit(out, sizeof(CacheHeader));
+	buf__hdr(out)->len = sizeof(CacheHeader);
+	write_section(&out, &header, SECTION_STMTS, ast->stmts, buf_len(ast->stmts));
+	write_section(&out, &header, SECTION_EXPRS, ast->exprs, buf_len(ast->exprs));
+	write_section(&out, &header, SECTION_DATA_TYPES, ast->data_types,
+				  buf_len(ast->data_types));
+	write_section(&out, &header, SECTION_FIELDS, ast->fields, buf_len(ast->fields));
+	write_section(&out, &header, SECTION_BRANCHES, ast->branches,
+				  buf_len(ast->branches));
+	write_section(&out, &header, SECTION_LISTS, ast->lists, buf_len(ast->lists));
+	write_section(&out, &header, SECTION_TOKENS, tokens, buf_len(tokens));
+	write_section(&out, &header, SECTION_LOADS, cached_loads, buf_len(cached_loads));
+	write_section(&out, &header, SECTION_STRINGS, strings, buf_len(strings));
+	memcpy(out, &header, sizeof(CacheHeader));
+
+	buf_free(strings);
+	map_free(&string_indices);
+	buf_free(tokens);
+	buf_free(cached_loads);
+
+	mkdir(cache_dir, 0755);
+	char* fpath = cache_path(cache_dir, hash);
+	char* tmp_fpath = null;
+	buf_printf(tmp_fpath, "%s.%d.tmp", fpath, (int)getpid());
+
+	error_code err = ETHER_ERROR;
+	FILE* fp = fopen(tmp_fpath, "wb");
+	if (fp) {
+		bool written = fwrite(out, 1, buf_len(out), fp) == buf_len(out);
+		if (fclose(fp) == 0 && written && rename(tmp_fpath, fpath) == 0) {
+			err = ETHER_SUCCESS;
+		}
+		else {
+			remove(tmp_fpath);
+		}
+	}
+
+	buf_free(out);
+	buf_free(fpath);
+	buf_free(tmp_fpath);
+	return err;
+}
+
+/* identifies the compiler that writes or reads a cache. the file holds
+ * kinds and trees as this build makes them, which a hand-bumped
+ * version misses when an enum is reordered or the parser changes. the
+ * size and modification time of the executable change with every
+ * build; the compile time of this file and the kind ranges are there
+ * for when /proc is not mounted. */
+static u64 build_id(void) {
+	const char* compiled = __DATE__ " " __TIME__;
+	u32 kinds[] = {
+		TOKEN_TYPE_LAST, KEYWORD_TYPE_LAST, EXPR_TYPE_LAST, STMT_TYPE_LAST,
+		KEYWORD_SET, KEYWORD_INT, KEYWORD_NULL,
+	};
+
+	u64 id = 0xcbf29ce484222325ull;
+	id = hash_bytes(id, (void*)compiled, strlen(compiled));
+	id = hash_bytes(id, kinds, sizeof(kinds));
+
+	struct stat st;
+	if (stat("/proc/self/exe", &st) == 0) {
+		u64 exe[2] = { (u64)st.st_size, (u64)st.st_mtime };
+		id = hash_bytes(id, exe, sizeof(exe));
+	}
+	return id;
+}
+
+/* FNV-1a, continuing from 'hash' */
+static u64 hash_bytes(u64 hash, void* bytes, u64 len) {
+	for (u64 i = 0; i < len; ++i) {
+		hash ^= ((uchar*)bytes)[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static char* cache_path(char* cache_dir, u64 hash) {
+	char* fpath = null;
+	buf_printf(fpath, "%s/%016lx.ast", cache_dir, hash);
+	return fpath;
+}
+
+/* null for an empty section; 'cache' itself if the section does not
+ * fit in the file */
+static void* read_section(SourceFile* cache, CacheHeader* header,
+						  CacheSection section) {
+	u64 offset = header->sections[section];
+	if (offset % AST_CACHE_ALIGNMENT != 0 ||
+		offset > cache->len || cache->len - offset < sizeof(BufHdr)) {
+		return cache;
+	}
+
+	BufHdr* hdr = (BufHdr*)(cache->contents + offset);
+	if (hdr->len > (cache->len - offset - sizeof(BufHdr)) / elem_sizes[section]) {
+		return cache;
+	}
+	return hdr->len ? hdr->buf : null;
+}
+
+/* every string is interned once, tokens refer to them by index */
+static char** read_strings(char* section) {
+	char** strings = null;
+	char* cur = section;
+	char* end = section + buf_len(section);
+	while (cur < end) {
+		char* str_end = (char*)memchr(cur, '\0', end - cur);
+		if (!str_end) break;
+		buf_push(strings, str_intern_range(cur, str_end));
+		cur = str_end + 1;
+	}
+	return strings;
+}
+
+static bool tokens_valid(CachedToken* tokens, char** strings, SourceFile* file) {
+	for (u64 i = 0; i < buf_len(tokens); ++i) {
+		CachedToken* t = &tokens[i];
+		if ((t->lexeme != FLAT_NONE && t->lexeme >= buf_len(strings)) ||
+			t->type > TOKEN_TYPE_LAST || t->keyword > KEYWORD_TYPE_LAST ||
+			!position_valid(file, t->line, t->column)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* diagnostics print the line a token is on and point at its column,
+ * so both have to be in the file; a token may start at the end of a
+ * line, as EOF does */
+static bool position_valid(SourceFile* file, u32 line, u32 column) {
+	if (line == 0 || column == 0) return false;
+	char* line_start = get_line_at(file, line);
+	if (!line_start) return false;
+
+	char* next_line = get_line_at(file, (u64)line + 1);
+	char* line_end = next_line ? next_line - 1 : file->contents + file->len;
+	return column - 1 <= (u64)(line_end - line_start);
+}
+
+static Token read_token(CachedToken* cached, char** strings, SourceFile* file) {
+	Token t;
+	t.type = (TokenType)cached->type;
+	t.keyword = (KeywordType)cached->keyword;
+	t.lexeme = cached->lexeme == FLAT_NONE ? null : strings[cached->lexeme];
+	t.symbol = t.lexeme ? str_symbol(t.lexeme) : 0;
+	t.srcfile = file;
+	t.line = cached->line;
+	t.column = cached->column;
+	return t;
+}
+
+static void write_section(char** out, CacheHeader* header, CacheSection section,
+						  void* elems, u64 len) {
+	u64 offset = (buf_len(*out) + AST_CACHE_ALIGNMENT - 1) &
+		~(u64)(AST_CACHE_ALIGNMENT - 1);
+	u64 size = len * elem_sizes[section];
+	buf_fit(*out, offset + sizeof(BufHdr) + size);
+	memset(*out + buf_len(*out), 0, offset - buf_len(*out));
+
+	BufHdr hdr;
+	hdr.len = len;
+	hdr.cap = len;
+	memcpy(*out + offset, &hdr, sizeof(BufHdr));
+	if (size) memcpy(*out + offset + sizeof(BufHdr), elems, size);
+	buf__hdr(*out)->len = offset + sizeof(BufHdr) + size;
+	header->sections[section] = offset;
+}
+
+/* lexemes are interned, so equal strings are stored once; 'strings'
+ * holds them one after the other, each terminated by '\0' */
+static CachedToken write_token(Token* t, char** strings, Map* string_indices) {
+	CachedToken cached;
+	cached.type = (u8)t->type;
+	cached.keyword = (u8)t->keyword;
+	cached.lexeme = FLAT_NONE;
+	cached.column = t->column;
+	cached.line = (u32)t->line;
+
+	if (t->lexeme) {
+		u64 idx = map_get(string_indices, (u64)t->lexeme);
+		if (!idx) {
+			u64 len = strlen(t->lexeme);
+			buf_fit(*strings, buf_len(*strings) + len + 1);
+			memcpy(*strings + buf_len(*strings), t->lexeme, len + 1);
+			buf__hdr(*strings)->len += len + 1;
+			idx = string_indices->len + 1;
+			map_put(string_indices, (u64)t->lexeme, idx);
+		}
+		cached.lexeme = (u32)(idx - 1);
+	}
+	return cached;
+}
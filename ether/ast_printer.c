@@ -2,6 +2,25 @@
 
 static uint tab_count;
 
+/* what is left to print of the expression being printed, see
+ * print_expr */
+typedef enum {
+	PRINT_EXPR,
+	PRINT_TOKEN,
+	PRINT_STRING,
+} PrintItemType;
+
+typedef struct {
+	PrintItemType type;
+	union {
+		Expr* expr;
+		Token* token;
+		const char* str;
+	};
+} PrintItem;
+
+static PrintItem* pending_items;
+
 static void print_stmt(Stmt*);
 static void print_stmt_with_newline(Stmt*);
 static void print_struct(Stmt*);
@@ -26,6 +45,9 @@ static void print_null_expr(Expr*);
 static void print_bool_expr(Expr*);
 static void print_variable_expr(Expr*);
 static void print_func_call(Expr*);
+static void later_expr(Expr*);
+static void later_token(Token*);
+static void later_string(const char*);
 
 static void print_data_type(DataType*);
 static void print_token(Token*);
@@ -47,6 +69,7 @@ void print_ast_debug(Stmt** stmts) {
 		print_stmt_with_newline(stmts[i]);
 	}
 	print_newline();
+	buf_free(pending_items);
 }
 
 static void print_stmt(Stmt* stmt) {
@@ -256,23 +279,46 @@ static void print_expr_stmt(Stmt* stmt) {
 	print_expr(stmt->expr);
 }
 
-static void print_expr(Expr* expr) {
-	switch (expr->type) {
-		case EXPR_DOT_ACCESS: print_dot_access_expr(expr); break;
-		case EXPR_NUMBER: print_number_expr(expr); break;
-		case EXPR_CHAR: print_char_expr(expr); break;	
-		case EXPR_STRING: print_string_expr(expr); break;
-		case EXPR_NULL: print_null_expr(expr); break;
-		case EXPR_BOOL: print_bool_expr(expr); break;	
-		case EXPR_VARIABLE: print_variable_expr(expr); break;
-		case EXPR_FUNC_CALL: print_func_call(expr); break;
+/* iterative, expressions can nest deeper than the C stack allows. the
+ * print_*_expr functions print what comes before their first operand
+ * and schedule the rest, last item first */
+static void print_expr(Expr* root) {
+	u64 base = buf_len(pending_items);
+	later_expr(root);
+	while (buf_len(pending_items) > base) {
+		PrintItem item = pending_items[buf_len(pending_items) - 1];
+		buf_pop(pending_items);
+
+		switch (item.type) {
+			case PRINT_TOKEN: print_token(item.token); continue;
+			case PRINT_STRING: print_string(item.str); continue;
+			case PRINT_EXPR: break;
+		}
+
+		Expr* expr = item.expr;
+		switch (expr->type) {
+			case EXPR_DOT_ACCESS: print_dot_access_expr(expr); break;
+			case EXPR_NUMBER: print_number_expr(expr); break;
+			case EXPR_CHAR: print_char_expr(expr); break;	
+			case EXPR_STRING: print_string_expr(expr); break;
+			case EXPR_NULL: print_null_expr(expr); break;
+			case EXPR_BOOL: print_bool_expr(expr); break;	
+			case EXPR_VARIABLE: print_variable_expr(expr); break;
+			case EXPR_FUNC_CALL:
+			case EXPR_SET:
+			case EXPR_DEREF:
+			case EXPR_ADDR:
+			case EXPR_AT:
+			case EXPR_ARITHMETIC:
+			case EXPR_COMPARISON: print_func_call(expr); break;
+		}
 	}
 }
 
 static void print_dot_access_expr(Expr* expr) {
-	print_expr(expr->dot.left);
-	print_char('.');
-	print_token(expr->dot.right);
+	later_token(expr->dot.right);
+	later_string(".");
+	later_expr(expr->dot.left);
 }
 
 static void print_number_expr(Expr* expr) {
@@ -309,13 +355,32 @@ static void print_func_call(Expr* expr) {
 	print_token(expr->func_call.callee);
 
 	if (args_len != 0) print_space();
-	for (u64 i = 0; i < args_len; ++i) {
-		print_expr(expr->func_call.args[i]);
-		if (i < (args_len - 1)) {
-			print_space();
-		}
+	later_string("]");
+	for (u64 i = args_len; i > 0; --i) {
+		later_expr(expr->func_call.args[i - 1]);
+		if (i != 1) later_string(" ");
 	}
-	print_right_bracket();
+}
+
+static void later_expr(Expr* expr) {
+	PrintItem item;
+	item.type = PRINT_EXPR;
+	item.expr = expr;
+	buf_push(pending_items, item);
+}
+
+static void later_token(Token* token) {
+	PrintItem item;
+	item.type = PRINT_TOKEN;
+	item.token = token;
+	buf_push(pending_items, item);
+}
+
+static void later_string(const char* str) {
+	PrintItem item;
+	item.type = PRINT_STRING;
+	item.str = str;
+	buf_push(pending_items, item);
 }
 
 static void print_data_type(DataType* data_type) {
@@ -27,3 +27,30 @@ void buf__shrink(const void* buf, u64 size) {
 
 	buf__hdr(buf)->len -= size;
 }
+
+/* appends the formatted string without its terminator, so that the
+ * next append overwrites it; the buffer always stays '\0'-terminated */
+char* buf__printf(char* buf, const char* fmt, ...) {
+	va_list ap;
+	va_start(ap, fmt);
+	buf = buf__vprintf(buf, fmt, ap);
+	va_end(ap);
+	return buf;
+}
+
+char* buf__vprintf(char* buf, const char* fmt, va_list ap) {
+	va_list ap_copy;
+	va_copy(ap_copy, ap);
+
+	u64 avail = buf_cap(buf) - buf_len(buf);
+	int len = vsnprintf(buf ? buf_end(buf) : null, avail, fmt, ap);
+	assert(len >= 0);
+	if ((u64)len + 1 > avail) {
+		buf_fit(buf, buf_len(buf) + (u64)len + 1);
+		vsnprintf(buf_end(buf), (u64)len + 1, fmt, ap_copy);
+	}
+	va_end(ap_copy);
+
+	if (buf) buf__hdr(buf)->len += (u64)len;
+	return buf;
+}
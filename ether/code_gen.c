@@ -8,6 +8,25 @@ static SourceFile* srcfile;
 static char* output_code;
 static uint tab_count;
 
+/* what is left to print of the expressions being generated; see
+ * gen_expr */
+typedef enum {
+	GEN_EXPR,
+	GEN_TOKEN,
+	GEN_STRING,
+} GenItemType;
+
+typedef struct {
+	GenItemType type;
+	union {
+		Expr* expr;
+		Token* token;
+		char* str;
+	};
+} GenItem;
+
+static GenItem* pending_items;
+
 static void code_gen_destroy(void);
 
 static void gen_include_headers(void);
@@ -29,6 +48,7 @@ static void gen_func_prototype(Stmt*);
 static void gen_file(Stmt**);
 static void gen_func(Stmt*);
 static void gen_extern_stmt(Stmt*);
+static void gen_body(Stmt**);
 static void gen_stmt(Stmt*);
 static void gen_var_decl(Stmt*);
 static void gen_if_stmt(Stmt*);
@@ -53,6 +73,9 @@ static void gen_addr_expr(Expr*);
 static void gen_at_expr(Expr*);
 static void gen_arithmetic_expr(Expr*);
 static void gen_comparison_expr(Expr*);
+static void later_expr(Expr*);
+static void later_token(Token*);
+static void later_string(char*);
 
 static void print_data_type(DataType*);
 static void print_token(Token*);
@@ -99,6 +122,7 @@ void code_gen_run(void) {
 
 static void code_gen_destroy(void) {
 	buf_free(output_code);
+	buf_free(pending_items);
 }
 
 static void gen_defines(void) {
@@ -303,11 +327,8 @@ static void gen_func(Stmt* stmt) {
 	print_space();
 	print_left_brace();
 	print_newline();
-	Stmt** body = stmt->func.body;
 	tab_count++;
-	for (u64 i = 0; i < buf_len(body); ++i) {
-		gen_stmt(body[i]);
-	}
+	gen_body(stmt->func.body);
 	tab_count--;
 	print_right_brace();
 	print_newline();
@@ -323,6 +344,12 @@ static void gen_extern_stmt(Stmt* stmt) {
 	print_newline();
 }
 
+static void gen_body(Stmt** body) {
+	for (u64 i = 0; i < buf_len(body); ++i) {
+		gen_stmt(body[i]);
+	}
+}
+
 static void gen_stmt(Stmt* stmt) {
 	print_tabs_by_indentation();
 	switch (stmt->type) {
@@ -385,9 +412,7 @@ static void gen_if_branch(IfBranch* branch, IfBranchType type) {
 	print_newline();
 	
 	tab_count++;
-	for (u64 i = 0; i < buf_len(branch->body); ++i) {
-		gen_stmt(branch->body[i]);
-	}
+	gen_body(branch->body);
 	tab_count--;
 	
 	print_tabs_by_indentation();
@@ -396,22 +421,21 @@ static void gen_if_branch(IfBranch* branch, IfBranchType type) {
 }
 
 static void gen_for_stmt(Stmt* stmt) {
+	Token* counter = stmt->for_stmt.counter->var_decl.identifier;
 	/* TODO: if for loop counter is modifiable, change this */
 	print_string("for (int ");
-	print_token(stmt->for_stmt.counter->var_decl.identifier);
+	print_token(counter);
 	print_string(" = 0; ");
-	print_token(stmt->for_stmt.counter->var_decl.identifier);
+	print_token(counter);
 	print_string(" < ");
 	gen_expr(stmt->for_stmt.to);
 	print_string("; ++");
-	print_token(stmt->for_stmt.counter->var_decl.identifier);
+	print_token(counter);
 	print_string(") {");
 	print_newline();
 
 	tab_count++;
-	for (u64 i = 0; i < buf_len(stmt->for_stmt.body); ++i) {
-		gen_stmt(stmt->for_stmt.body[i]);
-	}
+	gen_body(stmt->for_stmt.body);
 	tab_count--;
 	
 	print_tabs_by_indentation();
@@ -426,9 +450,7 @@ static void gen_while_stmt(Stmt* stmt) {
 	print_newline();
 
 	tab_count++;
-	for (u64 i = 0; i < buf_len(stmt->while_stmt.body); ++i) {
-		gen_stmt(stmt->while_stmt.body[i]);
-	}
+	gen_body(stmt->while_stmt.body);
 	tab_count--;
 	
 	print_tabs_by_indentation();
@@ -454,27 +476,51 @@ static void gen_expr_stmt(Stmt* stmt) {
 	print_newline();
 }
 
-static void gen_expr(Expr* expr) {
-	switch (expr->type) {
-		case EXPR_DOT_ACCESS: gen_dot_access_expr(expr); break;
-		case EXPR_NUMBER: gen_number_expr(expr); break;
-		case EXPR_CHAR: gen_char_expr(expr); break;	
-		case EXPR_STRING: gen_string_expr(expr); break;
-		case EXPR_NULL: gen_null_expr(expr); break;
-		case EXPR_BOOL: gen_bool_expr(expr); break;	
-		case EXPR_VARIABLE: gen_variable_expr(expr); break;
-		case EXPR_FUNC_CALL: gen_func_call(expr); break;	
+/* expressions nest far deeper than the C stack allows, so they are
+ * printed from an explicit stack of items. a gen_*_expr function
+ * prints what comes before the first operand right away and schedules
+ * the rest (operands, separators, closing parens) through the later_*
+ * functions; those have to be called in reverse, last item first. */
+static void gen_expr(Expr* root) {
+	u64 base = buf_len(pending_items);
+	later_expr(root);
+	while (buf_len(pending_items) > base) {
+		GenItem item = pending_items[buf_len(pending_items) - 1];
+		buf_pop(pending_items);
+
+		switch (item.type) {
+			case GEN_TOKEN: print_token(item.token); continue;
+			case GEN_STRING: print_string(item.str); continue;
+			case GEN_EXPR: break;
+		}
+
+		Expr* expr = item.expr;
+		switch (expr->type) {
+			case EXPR_DOT_ACCESS: gen_dot_access_expr(expr); break;
+			case EXPR_NUMBER: gen_number_expr(expr); break;
+			case EXPR_CHAR: gen_char_expr(expr); break;	
+			case EXPR_STRING: gen_string_expr(expr); break;
+			case EXPR_NULL: gen_null_expr(expr); break;
+			case EXPR_BOOL: gen_bool_expr(expr); break;	
+			case EXPR_VARIABLE: gen_variable_expr(expr); break;
+			case EXPR_FUNC_CALL: gen_func_call(expr); break;	
+			case EXPR_SET: gen_set_expr(expr); break;
+			case EXPR_DEREF: gen_deref_expr(expr); break;
+			case EXPR_ADDR: gen_addr_expr(expr); break;
+			case EXPR_AT: gen_at_expr(expr); break;
+			case EXPR_ARITHMETIC: gen_arithmetic_expr(expr); break;
+			case EXPR_COMPARISON: gen_comparison_expr(expr); break;
+		}
 	}
 }
 
 static void gen_dot_access_expr(Expr* expr) {
 	print_left_paren();
 	print_left_paren();
-	gen_expr(expr->dot.left);
-	print_right_paren();
-	print_string(expr->dot.is_left_pointer ? "->" : ".");
-	print_token(expr->dot.right);
-	print_right_paren();
+	later_string(")");
+	later_token(expr->dot.right);
+	later_string(expr->dot.is_left_pointer ? ")->" : ").");
+	later_expr(expr->dot.left);
 }
 
 static void gen_number_expr(Expr* expr) {
@@ -506,127 +552,103 @@ static void gen_variable_expr(Expr* expr) {
 }
 
 static void gen_func_call(Expr* expr) {
-	if (expr->func_call.callee->type == TOKEN_IDENTIFIER) {
-		print_token(expr->func_call.callee);
-		print_left_paren();
-
-		Expr** args = expr->func_call.args; 
-		for (u64 i = 0; i < buf_len(args); ++i) {
-			gen_expr(args[i]);
-
-			if (i != (buf_len(args) - 1)) {
-				print_comma();
-				print_space();
-			}
-		}
-		print_right_paren();
-	}
-
-	else if (expr->func_call.callee->type == TOKEN_KEYWORD) {
-		if (str_intern(expr->func_call.callee->lexeme) ==
-			str_intern("set")) {
-			gen_set_expr(expr);
-		}
-		else if (str_intern(expr->func_call.callee->lexeme) ==
-			str_intern("deref")) {
-			gen_deref_expr(expr);
-		}
-		else if (str_intern(expr->func_call.callee->lexeme) ==
-			str_intern("addr")) {
-			gen_addr_expr(expr);
-		}
-		else if (str_intern(expr->func_call.callee->lexeme) ==
-			str_intern("at")) {
-			gen_at_expr(expr);
-		}
-	}
+	print_token(expr->func_call.callee);
+	print_left_paren();
 
-	else {
-		switch (expr->func_call.callee->type) {
-			case TOKEN_PLUS:
-			case TOKEN_MINUS:
-			case TOKEN_STAR:
-			case TOKEN_SLASH: 
-			case TOKEN_PERCENT:
-				gen_arithmetic_expr(expr); return;
-
-			case TOKEN_EQUAL: 
-			case TOKEN_LESS:
-			case TOKEN_LESS_EQUAL:
-			case TOKEN_GREATER:
-			case TOKEN_GREATER_EQUAL: 
-				gen_comparison_expr(expr); return;
-
-			default: return;	
-		}
+	Expr** args = expr->func_call.args;
+	u64 arg_count = buf_len(args);
+	later_string(")");
+	for (u64 i = arg_count; i > 0; --i) {
+		later_expr(args[i - 1]);
+		if (i != 1) later_string(", ");
 	}
 }
 
 static void gen_set_expr(Expr* expr) {
+	Expr** args = expr->func_call.args;
 	print_left_paren();
-	gen_expr(expr->func_call.args[0]);
-	print_space();
-	print_equal();
-	print_space();
-	gen_expr(expr->func_call.args[1]);
-	print_right_paren();
+	later_string(")");
+	later_expr(args[1]);
+	later_string(" = ");
+	later_expr(args[0]);
 }
 
 static void gen_deref_expr(Expr* expr) {
+	Expr** args = expr->func_call.args;
 	print_left_paren();
 	print_char('*');
-	gen_expr(expr->func_call.args[0]);
-	print_right_paren();
+	later_string(")");
+	later_expr(args[0]);
 }
 
 static void gen_addr_expr(Expr* expr) {
+	Expr** args = expr->func_call.args;
 	print_left_paren();
 	print_char('&');
-	gen_expr(expr->func_call.args[0]);
-	print_right_paren();
+	later_string(")");
+	later_expr(args[0]);
 }
 
 static void gen_at_expr(Expr* expr) {
+	Expr** args = expr->func_call.args;
 	print_left_paren();
 	print_left_paren();
-	gen_expr(expr->func_call.args[0]);
-	print_right_paren();
-	print_char('[');
-	gen_expr(expr->func_call.args[1]);
-	print_char(']');
-	print_right_paren();
+	later_string("])");
+	later_expr(args[1]);
+	later_string(")[");
+	later_expr(args[0]);
 }
 
 static void gen_arithmetic_expr(Expr* expr) {
 	print_left_paren();
 	Expr** args = expr->func_call.args;
-	for (u64 i = 0; i < buf_len(args); ++i) {
-		gen_expr(args[i]);
-		
-		if (i != (buf_len(args) - 1)) {
-			print_space();
-			print_token(expr->func_call.callee);
-			print_space();
+	u64 arg_count = buf_len(args);
+	later_string(")");
+	for (u64 i = arg_count; i > 0; --i) {
+		later_expr(args[i - 1]);
+		if (i != 1) {
+			later_string(" ");
+			later_token(expr->func_call.callee);
+			later_string(" ");
 		}
 	}
-	print_right_paren();
 }
 
 static void gen_comparison_expr(Expr* expr) {
 	print_left_paren();
 	Expr** args = expr->func_call.args;
-	gen_expr(args[0]);
-	print_space();
+	later_string(")");
+	later_expr(args[1]);
+	later_string(" ");
 	if (expr->func_call.callee->type == TOKEN_EQUAL) {
-		print_equal();
-		print_equal();
+		later_string("==");
 	}
 	else {
-		print_token(expr->func_call.callee);
+		later_token(expr->func_call.callee);
 	}
-	print_space();
-	gen_expr(args[1]);
-	print_right_paren();
+	later_string(" ");
+	later_expr(args[0]);
+}
+
+static void later_expr(Expr* expr) {
+	GenItem item;
+	item.type = GEN_EXPR;
+	item.expr = expr;
+	buf_push(pending_items, item);
+}
+
+static void later_token(Token* token) {
+	GenItem item;
+	item.type = GEN_TOKEN;
+	item.token = token;
+	buf_push(pending_items, item);
+}
+
+static void later_string(char* str) {
+	GenItem item;
+	item.type = GEN_STRING;
+	item.str = str;
+	buf_push(pending_items, item);
 }
 
 static void print_data_type(DataType* data_type) {
@@ -701,26 +723,25 @@ static void print_char(char c) {
 	buf_push(output_code, c);
 }
 
+/* the object file is named after the source file, with '.eth'
+ * replaced by '.o'; code read from standard input goes to 'a.o' */
 static void compile_output_code(void) {
 	FILE* gcc;
-	char* command_first_part = "gcc -g -w -fno-stack-protector -nostdlib -c -o ";
-	u64 command_first_part_len = strlen(command_first_part);
-	
-	char* command_last_part = " -xc -";
-	u64 command_last_part_len = strlen(command_last_part);
-
-	u64 filename_len = (strlen(srcfile->fpath) - 2);
-	u64 command_len = command_first_part_len +
-					  command_last_part_len +
-					  filename_len;
-	char* command = malloc(command_len + 1);
-	strncpy(command, command_first_part, command_first_part_len);
-	strncpy(command + command_first_part_len,
-			srcfile->fpath, filename_len - 1);
-	command[command_first_part_len + filename_len - 1] = 'o';
-	strncpy(command + command_first_part_len + filename_len,
-			command_last_part, command_last_part_len);
-	command[command_len] = '\0';
+	char* command = null;
+	buf_printf(command, "gcc -g -w -fno-stack-protector -nostdlib -c -o ");
+
+	char* fpath = srcfile->fpath;
+	u64 fpath_len = strlen(fpath);
+	if (strcmp(fpath, "-") == 0) {
+		buf_printf(command, "a");
+	}
+	else if (fpath_len > 4 && strcmp(fpath + fpath_len - 4, ".eth") == 0) {
+		buf_printf(command, "%.*s", (int)(fpath_len - 4), fpath);
+	}
+	else {
+		buf_printf(command, "%s", fpath);
+	}
+	buf_printf(command, ".o -xc -");
 	printf("command: ");
 	printf(command);
 	printf("\n");
@@ -728,8 +749,10 @@ static void compile_output_code(void) {
 	gcc = popen(command, "w");
 	if (!gcc) {
 		printf("error!"); /* TODO: nice error message */
+		buf_free(command);
 		return;
 	}
 	fputs(output_code, gcc);
 	pclose(gcc);
+	buf_free(command);
 }
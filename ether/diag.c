@@ -0,0 +1,94 @@
+#define _DEFAULT_SOURCE
+#include <ether/ether.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/* every diagnostic is formatted into its own buffer (location, message,
+ * source line and marker) and written out with a single write(2) under
+ * a lock, so diagnostics from several threads never interleave.
+ * a thread can also defer its diagnostics: they are kept in the order
+ * they are reported until diag_flush_deferred writes them out or
+ * drops them. */
+
+static pthread_mutex_t diag_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread bool deferring;
+static __thread char** deferred;
+
+static const char* level_names[] = {
+	[DIAG_ERROR] = "error",
+	[DIAG_WARNING] = "warning",
+	[DIAG_NOTE] = "note",
+};
+
+static void emit(char*);
+static void write_all(char*, u64);
+
+void diag_report(DiagLevel level, SourceFile* file, u64 line, u32 column,
+				 const char* fmt, ...) {
+	va_list ap;
+	va_start(ap, fmt);
+	diag_vreport(level, file, line, column, fmt, ap);
+	va_end(ap);
+}
+
+void diag_vreport(DiagLevel level, SourceFile* file, u64 line, u32 column,
+				  const char* fmt, va_list ap) {
+	char* text = null;
+	buf_printf(text, "%s:%ld:%d: %s: ",
+			   file->fpath, line, column, level_names[level]);
+	buf_vprintf(text, fmt, ap);
+	buf_push(text, '\n');
+
+	format_file_line_with_info(&text, file, line);
+	format_marker_arrow_with_info_ln(&text, file, line, column);
+	emit(text);
+}
+
+/* a line without a source location */
+void diag_message(const char* fmt, ...) {
+	char* text = null;
+	va_list ap;
+	va_start(ap, fmt);
+	buf_vprintf(text, fmt, ap);
+	va_end(ap);
+	buf_push(text, '\n');
+	emit(text);
+}
+
+void diag_defer(bool on) {
+	deferring = on;
+}
+
+/* stops deferring */
+void diag_flush_deferred(bool write) {
+	deferring = false;
+	for (u64 i = 0; i < buf_len(deferred); ++i) {
+		if (write) emit(deferred[i]);
+		else buf_free(deferred[i]);
+	}
+	buf_free(deferred);
+}
+
+static void emit(char* text) {
+	if (deferring) {
+		buf_push(deferred, text);
+		return;
+	}
+
+	pthread_mutex_lock(&diag_lock);
+	write_all(text, buf_len(text));
+	pthread_mutex_unlock(&diag_lock);
+	buf_free(text);
+}
+
+/* stdout is shared with the AST printer and code_gen, so anything they
+ * left in stdio's buffer has to go out first */
+static void write_all(char* text, u64 len) {
+	fflush(stdout);
+	while (len > 0) {
+		ssize_t written = write(STDOUT_FILENO, text, len);
+		if (written <= 0) return;
+		text += written;
+		len -= (u64)written;
+	}
+}
@@ -1,13 +1,14 @@
 #include <ether/ether.h>
 
 void ether_error(const char* fmt, ...) {
-	printf("ether: ");
-
+	char* msg = null;
 	va_list ap;
 	va_start(ap, fmt);
-	vprintf(fmt, ap);
+	buf_vprintf(msg, fmt, ap);
 	va_end(ap);
-	printf("\n");
+
+	diag_message("ether: %s", msg);
+	buf_free(msg);
 
 	exit(EXIT_FAILURE);
 }
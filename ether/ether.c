@@ -11,29 +11,35 @@ int main(int argc, char** argv) {
 	/* TODO: check if we have to free this pointer.
 	 * is it expensive to keep it around? */
 	SourceFile* srcfile = ether_read_file(argv[1]);
-	if (!srcfile->contents) {
+	if (!srcfile) {
 		ether_error("%s: no such file or directory", argv[1]);
 	}
 
+	parser_set_thread_count(0);
+
 	error_code err = false;
+
+#if PRINT_TOKENS
 	Lexer lexer;
-	Token** tokens = lexer_run(&lexer, srcfile, &err);
+	TokenStore* tokens = lexer_run(&lexer, srcfile, &err);
 	if (err == ETHER_ERROR) quit();
 
-#if PRINT_TOKENS
 	printf("--- TOKENS ---\n");
-	for (uint i = 0; i < buf_len(tokens); ++i) {
+	for (u64 i = 0; i < tokens->len; ++i) {
+		Token t = token_store_get(tokens, srcfile, i);
 		printf("token: '%s' (%d) at line %ld, col %d\n",
-			   (tokens[i]->lexeme), tokens[i]->type,
-			   tokens[i]->line, tokens[i]->column);
+			   t.lexeme, t.type, t.line, t.column);
 	}
 	printf("--- END ---\n\n");
+	token_store_free(tokens);
 #endif
 
 	err = false;
-	Parser parser;
-	Stmt** stmts = parser_run(&parser, tokens, srcfile, &err);
+	Loader loader;
+	loader_init(&loader, getenv("ETHER_CACHE_DIR"));
+	loader_load(&loader, srcfile, &err);
 	if (err == ETHER_ERROR) quit();
+	Stmt** stmts = loader_stmts(&loader);
 
 #if PRINT_AST
 	printf("--- AST ---\n");
@@ -41,16 +47,18 @@ int main(int argc, char** argv) {
 	printf("--- END ---\n");
 #endif
 
-	linker_init(stmts);
-	Stmt** structs = linker_run(&err);
-	if (err == ETHER_ERROR) quit();
-
+	/* names are linked and types resolved in a single walk, over
+	 * cached modules as well */
+	Stmt** structs = linker_init(stmts);
 	resolve_init(stmts, structs);
 	err = resolve_run();
+	linker_destroy();
 	if (err == ETHER_ERROR) quit();
+	if (loader.cache_dir) loader_save_cache(&loader);
 
 	code_gen_init(stmts, srcfile);
 	code_gen_run();
+	loader_free(&loader);
 }
 
 inline static void quit(void) {
@@ -0,0 +1,852 @@
+#include <ether/ether.h>
+
+/* the tree is flattened in two passes: the first one numbers every
+ * statement, so that references to statements that come later in the
+ * tree (calls to functions defined further down, struct fields) can be
+ * filled in by the second pass, which builds all the nodes. */
+
+/* an expression waiting to be built; its index goes to 'lists[slot]',
+ * or to the 'dot.left' of expression 'parent' */
+typedef struct {
+	Expr* expr;
+	u32 parent;
+	u32 slot;
+} PendingExpr;
+
+typedef struct {
+	FlatAst* ast;
+	Map stmt_indices;  /* Stmt* -> index + 1 */
+	Map token_indices; /* Token* -> index + 1 */
+	PendingExpr* pending_exprs;
+} FlatBuilder;
+
+static void number_stmts(FlatBuilder*, Stmt**);
+static void number_stmt(FlatBuilder*, Stmt*);
+static void number_branch(FlatBuilder*, IfBranch*);
+
+static FlatRange build_stmt_list(FlatBuilder*, Stmt**);
+static void build_stmt(FlatBuilder*, Stmt*);
+static u32 build_branch(FlatBuilder*, IfBranch*);
+static u32 build_expr(FlatBuilder*, Expr*);
+static u32 build_expr_node(FlatBuilder*, Expr*);
+static u32 build_data_type(FlatBuilder*, DataType*);
+static u32 stmt_index(FlatBuilder*, Stmt*);
+static u32 token_index(FlatBuilder*, Token*);
+static FlatRange reserve_list(FlatBuilder*, u64);
+
+typedef struct {
+	FlatAst* ast;
+	Arena* arena;
+	Token* tokens;
+	Stmt* stmts;
+	Expr* exprs;
+	DataType* data_types;
+	Field* fields;
+	IfBranch* branches;
+} FlatExpander;
+
+static void expand_stmt(FlatExpander*, u32);
+static void expand_expr(FlatExpander*, u32);
+static void** expand_list(FlatExpander*, FlatRange, void*, u64);
+static void* expand_pool(Arena*, u64, u64);
+
+#define EXPANDED(e, pool, idx) ((idx) == FLAT_NONE ? null : &(e)->pool[idx])
+
+typedef enum {
+	POOL_STMTS,
+	POOL_EXPRS,
+	POOL_DATA_TYPES,
+	POOL_FIELDS,
+	POOL_BRANCHES,
+	POOL_TOKENS,
+	POOL_COUNT,
+} FlatPool;
+
+/* where a statement is in the tree decides which kinds it can be */
+typedef enum {
+	PLACE_TOP_LEVEL,
+	PLACE_BODY,
+	PLACE_PARAM,
+	PLACE_COUNTER,
+} StmtPlace;
+
+typedef struct {
+	FlatAst* ast;
+	u64 lens[POOL_COUNT];
+	u64 list_len;
+	bool* claimed[POOL_COUNT]; /* tokens are shared, so never claimed */
+} FlatChecker;
+
+static bool check_stmt(FlatChecker*, FlatStmt*);
+static bool check_expr(FlatChecker*, FlatExpr*);
+static bool check_index(FlatChecker*, FlatPool, u32, bool);
+static bool check_list(FlatChecker*, FlatPool, FlatRange);
+static bool check_ref(FlatChecker*, u32, StmtType, bool);
+static bool check_data_type_token(Token*);
+static bool claim_stmt_children(FlatChecker*, u32);
+static bool claim_expr_children(FlatChecker*, u32);
+static bool claim_stmts(FlatChecker*, FlatRange, u32, StmtPlace);
+static bool claim_stmt(FlatChecker*, u32, u32, StmtPlace);
+static bool claim_branch(FlatChecker*, u32, u32, bool);
+static bool claim_expr(FlatChecker*, u32, u32, bool);
+static bool claim(FlatChecker*, FlatPool, u32, bool);
+
+void flat_ast_build(FlatAst* ast, Stmt** stmts) {
+	memset(ast, 0, sizeof(FlatAst));
+	FlatBuilder b;
+	b.ast = ast;
+	b.stmt_indices = (Map){ 0 };
+	b.token_indices = (Map){ 0 };
+	b.pending_exprs = null;
+
+	number_stmts(&b, stmts);
+	ast->top_level = build_stmt_list(&b, stmts);
+
+	map_free(&b.stmt_indices);
+	map_free(&b.token_indices);
+	buf_free(b.pending_exprs);
+}
+
+void flat_ast_free(FlatAst* ast) {
+	buf_free(ast->stmts);
+	buf_free(ast->exprs);
+	buf_free(ast->data_types);
+	buf_free(ast->fields);
+	buf_free(ast->branches);
+	buf_free(ast->lists);
+	buf_free(ast->tokens);
+}
+
+static void number_stmts(FlatBuilder* b, Stmt** stmts) {
+	for (u64 i = 0; i < buf_len(stmts); ++i) {
+		number_stmt(b, stmts[i]);
+	}
+}
+
+static void number_stmt(FlatBuilder* b, Stmt* stmt) {
+	FlatStmt empty = { 0 };
+	buf_push(b->ast->stmts, empty);
+	map_put(&b->stmt_indices, (u64)stmt, buf_len(b->ast->stmts));
+
+	switch (stmt->type) {
+		case STMT_FUNC: {
+			number_stmts(b, stmt->func.params);
+			number_stmts(b, stmt->func.body);
+		} break;
+
+		case STMT_IF: {
+			number_branch(b, stmt->if_stmt.if_branch);
+			for (u64 i = 0; i < buf_len(stmt->if_stmt.elif_branch); ++i) {
+				number_branch(b, stmt->if_stmt.elif_branch[i]);
+			}
+			number_branch(b, stmt->if_stmt.else_branch);
+		} break;
+
+		case STMT_FOR: {
+			number_stmt(b, stmt->for_stmt.counter);
+			number_stmts(b, stmt->for_stmt.body);
+		} break;
+
+		case STMT_WHILE: {
+			number_stmts(b, stmt->while_stmt.body);
+		} break;
+
+		case STMT_STRUCT:
+		case STMT_VAR_DECL:
+		case STMT_RETURN:
+		case STMT_EXPR: break;
+	}
+}
+
+static void number_branch(FlatBuilder* b, IfBranch* branch) {
+	if (branch) number_stmts(b, branch->body);
+}
+
+/* the statements of a list were numbered in order but not necessarily
+ * next to each other, so the list stores their indices */
+static FlatRange build_stmt_list(FlatBuilder* b, Stmt** stmts) {
+	FlatRange range = reserve_list(b, buf_len(stmts));
+	for (u64 i = 0; i < buf_len(stmts); ++i) {
+		b->ast->lists[range.start + i] = stmt_index(b, stmts[i]);
+	}
+	for (u64 i = 0; i < buf_len(stmts); ++i) {
+		build_stmt(b, stmts[i]);
+	}
+	return range;
+}
+
+static void build_stmt(FlatBuilder* b, Stmt* stmt) {
+	FlatStmt s;
+	memset(&s, 0, sizeof(FlatStmt));
+	s.type = (u8)stmt->type;
+
+	switch (stmt->type) {
+		case STMT_STRUCT: {
+			Field** fields = stmt->struct_stmt.fields;
+			s.struct_stmt.identifier = token_index(b, stmt->struct_stmt.identifier);
+			s.struct_stmt.fields = reserve_list(b, buf_len(fields));
+			for (u64 i = 0; i < buf_len(fields); ++i) {
+				FlatField f;
+				f.type = build_data_type(b, fields[i]->type);
+				f.identifier = token_index(b, fields[i]->identifier);
+				f.struct_referenced = stmt_index(b, fields[i]->struct_referenced);
+				buf_push(b->ast->fields, f);
+				b->ast->lists[s.struct_stmt.fields.start + i] =
+					(u32)(buf_len(b->ast->fields) - 1);
+			}
+		} break;
+
+		case STMT_FUNC: {
+			s.func.type = build_data_type(b, stmt->func.type);
+			s.func.identifier = token_index(b, stmt->func.identifier);
+			s.func.is_function = stmt->func.is_function;
+			s.func.public = stmt->func.public;
+			s.func.params = build_stmt_list(b, stmt->func.params);
+			s.func.body = build_stmt_list(b, stmt->func.body);
+		} break;
+
+		case STMT_VAR_DECL: {
+			s.var_decl.type = build_data_type(b, stmt->var_decl.type);
+			s.var_decl.identifier = token_index(b, stmt->var_decl.identifier);
+			s.var_decl.initializer = build_expr(b, stmt->var_decl.initializer);
+			s.var_decl.is_global_var = stmt->var_decl.is_global_var;
+			s.var_decl.is_variable = stmt->var_decl.is_variable;
+		} break;
+
+		case STMT_IF: {
+			IfBranch** elifs = stmt->if_stmt.elif_branch;
+			s.if_stmt.if_branch = build_branch(b, stmt->if_stmt.if_branch);
+			s.if_stmt.elif_branch = reserve_list(b, buf_len(elifs));
+			for (u64 i = 0; i < buf_len(elifs); ++i) {
+				u32 branch = build_branch(b, elifs[i]);
+				b->ast->lists[s.if_stmt.elif_branch.start + i] = branch;
+			}
+			s.if_stmt.else_branch = build_branch(b, stmt->if_stmt.else_branch);
+		} break;
+
+		case STMT_FOR: {
+			s.for_stmt.counter = stmt_index(b, stmt->for_stmt.counter);
+			build_stmt(b, stmt->for_stmt.counter);
+			s.for_stmt.to = build_expr(b, stmt->for_stmt.to);
+			s.for_stmt.body = build_stmt_list(b, stmt->for_stmt.body);
+		} break;
+
+		case STMT_WHILE: {
+			s.while_stmt.cond = build_expr(b, stmt->while_stmt.cond);
+			s.while_stmt.body = build_stmt_list(b, stmt->while_stmt.body);
+		} break;
+
+		case STMT_RETURN: {
+			s.return_stmt.expr = build_expr(b, stmt->return_stmt.expr);
+			s.return_stmt.function_referernced =
+				stmt_index(b, stmt->return_stmt.function_referernced);
+			s.return_stmt.keyword = token_index(b, stmt->return_stmt.keyword);
+		} break;
+
+		case STMT_EXPR: {
+			s.expr = build_expr(b, stmt->expr);
+		} break;
+	}
+
+	b->ast->stmts[stmt_index(b, stmt)] = s;
+}
+
+static u32 build_branch(FlatBuilder* b, IfBranch* branch) {
+	if (!branch) return FLAT_NONE;
+
+	FlatIfBranch fb;
+	fb.cond = build_expr(b, branch->cond);
+	fb.body = build_stmt_list(b, branch->body);
+	buf_push(b->ast->branches, fb);
+	return (u32)(buf_len(b->ast->branches) - 1);
+}
+
+/* expressions can nest too deep to recurse on, so the ones still to be
+ * built wait on 'b->pending_exprs'. operands are pushed in reverse,
+ * which numbers the expressions in pre-order like a recursive walk. */
+static u32 build_expr(FlatBuilder* b, Expr* root) {
+	if (!root) return FLAT_NONE;
+
+	u64 base = buf_len(b->pending_exprs);
+	PendingExpr first = { root, FLAT_NONE, FLAT_NONE };
+	buf_push(b->pending_exprs, first);
+
+	u32 root_idx = FLAT_NONE;
+	while (buf_len(b->pending_exprs) > base) {
+		PendingExpr pending = b->pending_exprs[buf_len(b->pending_exprs) - 1];
+		buf_pop(b->pending_exprs);
+
+		u32 idx = build_expr_node(b, pending.expr);
+		if (pending.slot != FLAT_NONE) {
+			b->ast->lists[pending.slot] = idx;
+		}
+		else if (pending.parent != FLAT_NONE) {
+			b->ast->exprs[pending.parent].dot.left = idx;
+		}
+		else {
+			root_idx = idx;
+		}
+	}
+	return root_idx;
+}
+
+/* builds 'expr' itself and queues its operands */
+static u32 build_expr_node(FlatBuilder* b, Expr* expr) {
+	FlatExpr empty = { 0 };
+	buf_push(b->ast->exprs, empty);
+	u32 idx = (u32)(buf_len(b->ast->exprs) - 1);
+
+	FlatExpr e;
+	memset(&e, 0, sizeof(FlatExpr));
+	e.type = (u8)expr->type;
+	e.head = token_index(b, expr->head);
+
+	switch (expr->type) {
+		case EXPR_FUNC_CALL:
+		case EXPR_SET:
+		case EXPR_DEREF:
+		case EXPR_ADDR:
+		case EXPR_AT:
+		case EXPR_ARITHMETIC:
+		case EXPR_COMPARISON: {
+			Expr** args = expr->func_call.args;
+			e.func_call.callee = token_index(b, expr->func_call.callee);
+			e.func_call.function_called =
+				stmt_index(b, expr->func_call.function_called);
+			e.func_call.args = reserve_list(b, buf_len(args));
+			for (u64 i = buf_len(args); i > 0; --i) {
+				PendingExpr arg = { args[i - 1], idx,
+									(u32)(e.func_call.args.start + i - 1) };
+				buf_push(b->pending_exprs, arg);
+			}
+		} break;
+
+		case EXPR_VARIABLE: {
+			e.variable.identifier = token_index(b, expr->variable.identifier);
+			e.variable.variable_decl_referenced =
+				stmt_index(b, expr->variable.variable_decl_referenced);
+		} break;
+
+		case EXPR_DOT_ACCESS: {
+			e.dot.left = FLAT_NONE;
+			e.dot.right = token_index(b, expr->dot.right);
+			e.dot.is_left_pointer = expr->dot.is_left_pointer;
+			PendingExpr left = { expr->dot.left, idx, FLAT_NONE };
+			buf_push(b->pending_exprs, left);
+		} break;
+
+		case EXPR_NUMBER:
+		case EXPR_CHAR:
+		case EXPR_STRING:
+		case EXPR_BOOL: {
+			e.token = token_index(b, expr->number);
+		} break;
+
+		case EXPR_NULL: {
+			e.token = FLAT_NONE;
+		} break;
+	}
+
+	b->ast->exprs[idx] = e;
+	return idx;
+}
+
+static u32 build_data_type(FlatBuilder* b, DataType* type) {
+	if (!type) return FLAT_NONE;
+
+	FlatDataType t;
+	t.type = token_index(b, type->type);
+	t.pointer_count = type->pointer_count;
+	buf_push(b->ast->data_types, t);
+	return (u32)(buf_len(b->ast->data_types) - 1);
+}
+
+static u32 stmt_index(FlatBuilder* b, Stmt* stmt) {
+	if (!stmt) return FLAT_NONE;
+	u64 idx = map_get(&b->stmt_indices, (u64)stmt);
+	/* into another module; the linker makes those again after a read */
+	if (!idx) return FLAT_NONE;
+	return (u32)(idx - 1);
+}
+
+/* tokens shared between nodes (e.g. an expression's head and its
+ * literal) are stored once */
+static u32 token_index(FlatBuilder* b, Token* t) {
+	if (!t) return FLAT_NONE;
+	u64 idx = map_get(&b->token_indices, (u64)t);
+	if (!idx) {
+		buf_push(b->ast->tokens, *t);
+		idx = buf_len(b->ast->tokens);
+		map_put(&b->token_indices, (u64)t, idx);
+	}
+	return (u32)(idx - 1);
+}
+
+static FlatRange reserve_list(FlatBuilder* b, u64 count) {
+	FlatRange range;
+	range.start = (u32)buf_len(b->ast->lists);
+	range.count = (u32)count;
+	if (!count) return range;
+	buf_fit(b->ast->lists, buf_len(b->ast->lists) + count);
+	buf__hdr(b->ast->lists)->len += count;
+	return range;
+}
+
+/* the inverse of flat_ast_build: every pool becomes an array of nodes
+ * in 'arena' and indices become pointers into them, so the nodes are
+ * filled in pool order and nothing needs to recurse. tokens are not
+ * copied; apart from them, 'ast' is not needed once this returns. */
+Stmt** flat_ast_expand(FlatAst* ast, Arena* arena) {
+	FlatExpander e;
+	e.ast = ast;
+	e.arena = arena;
+	e.tokens = ast->tokens;
+	e.stmts = (Stmt*)expand_pool(arena, buf_len(ast->stmts), sizeof(Stmt));
+	e.exprs = (Expr*)expand_pool(arena, buf_len(ast->exprs), sizeof(Expr));
+	e.data_types = (DataType*)expand_pool(arena, buf_len(ast->data_types),
+										  sizeof(DataType));
+	e.fields = (Field*)expand_pool(arena, buf_len(ast->fields), sizeof(Field));
+	e.branches = (IfBranch*)expand_pool(arena, buf_len(ast->branches),
+										sizeof(IfBranch));
+
+	for (u64 i = 0; i < buf_len(ast->data_types); ++i) {
+		e.data_types[i].type = EXPANDED(&e, tokens, ast->data_types[i].type);
+		e.data_types[i].pointer_count = ast->data_types[i].pointer_count;
+	}
+	for (u64 i = 0; i < buf_len(ast->fields); ++i) {
+		FlatField* f = &ast->fields[i];
+		e.fields[i].type = EXPANDED(&e, data_types, f->type);
+		e.fields[i].identifier = EXPANDED(&e, tokens, f->identifier);
+		e.fields[i].struct_referenced = EXPANDED(&e, stmts, f->struct_referenced);
+	}
+	for (u64 i = 0; i < buf_len(ast->branches); ++i) {
+		FlatIfBranch* b = &ast->branches[i];
+		e.branches[i].cond = EXPANDED(&e, exprs, b->cond);
+		e.branches[i].body = (Stmt**)expand_list(&e, b->body, e.stmts, sizeof(Stmt));
+	}
+	for (u64 i = 0; i < buf_len(ast->exprs); ++i) {
+		expand_expr(&e, (u32)i);
+	}
+	for (u64 i = 0; i < buf_len(ast->stmts); ++i) {
+		expand_stmt(&e, (u32)i);
+	}
+	return (Stmt**)expand_list(&e, ast->top_level, e.stmts, sizeof(Stmt));
+}
+
+static void expand_stmt(FlatExpander* e, u32 idx) {
+	FlatStmt* s = &e->ast->stmts[idx];
+	Stmt* stmt = &e->stmts[idx];
+	stmt->type = (StmtType)s->type;
+
+	switch (stmt->type) {
+		case STMT_STRUCT: {
+			stmt->struct_stmt.identifier =
+				EXPANDED(e, tokens, s->struct_stmt.identifier);
+			stmt->struct_stmt.fields = (Field**)expand_list(
+				e, s->struct_stmt.fields, e->fields, sizeof(Field));
+		} break;
+
+		case STMT_FUNC: {
+			stmt->func.type = EXPANDED(e, data_types, s->func.type);
+			stmt->func.identifier = EXPANDED(e, tokens, s->func.identifier);
+			stmt->func.params = (Stmt**)expand_list(e, s->func.params,
+													e->stmts, sizeof(Stmt));
+			stmt->func.body = (Stmt**)expand_list(e, s->func.body,
+												  e->stmts, sizeof(Stmt));
+			stmt->func.is_function = s->func.is_function;
+			stmt->func.public = s->func.public;
+		} break;
+
+		case STMT_VAR_DECL: {
+			stmt->var_decl.type = EXPANDED(e, data_types, s->var_decl.type);
+			stmt->var_decl.identifier = EXPANDED(e, tokens, s->var_decl.identifier);
+			stmt->var_decl.initializer = EXPANDED(e, exprs, s->var_decl.initializer);
+			stmt->var_decl.is_global_var = s->var_decl.is_global_var;
+			stmt->var_decl.is_variable = s->var_decl.is_variable;
+		} break;
+
+		case STMT_IF: {
+			stmt->if_stmt.if_branch = EXPANDED(e, branches, s->if_stmt.if_branch);
+			stmt->if_stmt.elif_branch = (IfBranch**)expand_list(
+				e, s->if_stmt.elif_branch, e->branches, sizeof(IfBranch));
+			stmt->if_stmt.else_branch = EXPANDED(e, branches, s->if_stmt.else_branch);
+		} break;
+
+		case STMT_FOR: {
+			stmt->for_stmt.counter = EXPANDED(e, stmts, s->for_stmt.counter);
+			stmt->for_stmt.to = EXPANDED(e, exprs, s->for_stmt.to);
+			stmt->for_stmt.body = (Stmt**)expand_list(e, s->for_stmt.body,
+													  e->stmts, sizeof(Stmt));
+		} break;
+
+		case STMT_WHILE: {
+			stmt->while_stmt.cond = EXPANDED(e, exprs, s->while_stmt.cond);
+			stmt->while_stmt.body = (Stmt**)expand_list(e, s->while_stmt.body,
+														e->stmts, sizeof(Stmt));
+		} break;
+
+		case STMT_RETURN: {
+			stmt->return_stmt.expr = EXPANDED(e, exprs, s->return_stmt.expr);
+			stmt->return_stmt.function_referernced =
+				EXPANDED(e, stmts, s->return_stmt.function_referernced);
+			stmt->return_stmt.keyword = EXPANDED(e, tokens, s->return_stmt.keyword);
+		} break;
+
+		case STMT_EXPR: {
+			stmt->expr = EXPANDED(e, exprs, s->expr);
+		} break;
+	}
+}
+
+static void expand_expr(FlatExpander* e, u32 idx) {
+	FlatExpr* x = &e->ast->exprs[idx];
+	Expr* expr = &e->exprs[idx];
+	expr->type = (ExprType)x->type;
+	expr->head = EXPANDED(e, tokens, x->head);
+
+	switch (expr->type) {
+		case EXPR_FUNC_CALL:
+		case EXPR_SET:
+		case EXPR_DEREF:
+		case EXPR_ADDR:
+		case EXPR_AT:
+		case EXPR_ARITHMETIC:
+		case EXPR_COMPARISON: {
+			expr->func_call.callee = EXPANDED(e, tokens, x->func_call.callee);
+			expr->func_call.args = (Expr**)expand_list(e, x->func_call.args,
+													   e->exprs, sizeof(Expr));
+			expr->func_call.function_called =
+				EXPANDED(e, stmts, x->func_call.function_called);
+		} break;
+
+		case EXPR_VARIABLE: {
+			expr->variable.identifier = EXPANDED(e, tokens, x->variable.identifier);
+			expr->variable.variable_decl_referenced =
+				EXPANDED(e, stmts, x->variable.variable_decl_referenced);
+		} break;
+
+		case EXPR_DOT_ACCESS: {
+			expr->dot.left = EXPANDED(e, exprs, x->dot.left);
+			expr->dot.right = EXPANDED(e, tokens, x->dot.right);
+			expr->dot.is_left_pointer = x->dot.is_left_pointer;
+		} break;
+
+		case EXPR_NUMBER:
+		case EXPR_CHAR:
+		case EXPR_STRING:
+		case EXPR_BOOL: {
+			expr->number = EXPANDED(e, tokens, x->token);
+		} break;
+
+		case EXPR_NULL: break;
+	}
+}
+
+/* a list of pointers to the nodes of 'pool' (of 'elem_size' each) that
+ * 'range' refers to, as a stretchy buffer in the arena */
+static void** expand_list(FlatExpander* e, FlatRange range, void* pool,
+						  u64 elem_size) {
+	if (range.count == 0) return null;
+
+	void** list = (void**)arena_buf_alloc(e->arena, range.count, sizeof(void*));
+	u32* indices = flat_list(e->ast, range);
+	for (u32 i = 0; i < range.count; ++i) {
+		list[i] = (char*)pool + indices[i] * elem_size;
+	}
+	return list;
+}
+
+static void* expand_pool(Arena* arena, u64 count, u64 elem_size) {
+	if (count == 0) return null;
+	return arena_alloc(arena, count * elem_size);
+}
+
+/* in two passes: the first checks every node on its own, which is all
+ * expanding needs: kinds are in range and indices are FLAT_NONE where
+ * allowed or inside their pool. the second checks the tree as a whole,
+ * which is what the linker and the later passes rely on: every node but
+ * the top-level statements is the child of exactly one other node,
+ * child statements and expressions come after their parent, as the
+ * builder numbers them, which rules out cycles, and each statement is
+ * of a kind its place allows. */
+bool flat_ast_check(FlatAst* ast) {
+	FlatChecker c;
+	c.ast = ast;
+	c.lens[POOL_STMTS] = buf_len(ast->stmts);
+	c.lens[POOL_EXPRS] = buf_len(ast->exprs);
+	c.lens[POOL_DATA_TYPES] = buf_len(ast->data_types);
+	c.lens[POOL_FIELDS] = buf_len(ast->fields);
+	c.lens[POOL_BRANCHES] = buf_len(ast->branches);
+	c.lens[POOL_TOKENS] = buf_len(ast->tokens);
+	c.list_len = buf_len(ast->lists);
+
+	bool ok = check_list(&c, POOL_STMTS, ast->top_level);
+	for (u64 i = 0; i < c.lens[POOL_TOKENS] && ok; ++i) {
+		ok = ast->tokens[i].lexeme != null;
+	}
+	for (u64 i = 0; i < c.lens[POOL_DATA_TYPES] && ok; ++i) {
+		ok = check_index(&c, POOL_TOKENS, ast->data_types[i].type, false) &&
+			 check_data_type_token(&ast->tokens[ast->data_types[i].type]);
+	}
+	for (u64 i = 0; i < c.lens[POOL_FIELDS] && ok; ++i) {
+		FlatField* f = &ast->fields[i];
+		ok = check_index(&c, POOL_DATA_TYPES, f->type, false) &&
+			 check_index(&c, POOL_TOKENS, f->identifier, false) &&
+			 check_ref(&c, f->struct_referenced, STMT_STRUCT, true);
+	}
+	for (u64 i = 0; i < c.lens[POOL_BRANCHES] && ok; ++i) {
+		ok = check_index(&c, POOL_EXPRS, ast->branches[i].cond, true) &&
+			 check_list(&c, POOL_STMTS, ast->branches[i].body);
+	}
+	for (u64 i = 0; i < c.lens[POOL_EXPRS] && ok; ++i) {
+		ok = check_expr(&c, &ast->exprs[i]);
+	}
+	for (u64 i = 0; i < c.lens[POOL_STMTS] && ok; ++i) {
+		ok = check_stmt(&c, &ast->stmts[i]);
+	}
+	if (!ok) return false;
+
+	for (uint p = 0; p < POOL_TOKENS; ++p) {
+		c.claimed[p] = (bool*)calloc(c.lens[p] + 1, sizeof(bool));
+		if (!c.claimed[p]) ok = false;
+	}
+	ok = ok && claim_stmts(&c, ast->top_level, FLAT_NONE, PLACE_TOP_LEVEL);
+	for (u64 i = 0; i < c.lens[POOL_STMTS] && ok; ++i) {
+		ok = claim_stmt_children(&c, (u32)i);
+	}
+	for (u64 i = 0; i < c.lens[POOL_EXPRS] && ok; ++i) {
+		ok = claim_expr_children(&c, (u32)i);
+	}
+	for (uint p = 0; p < POOL_TOKENS; ++p) {
+		for (u64 i = 0; i < c.lens[p] && ok; ++i) {
+			ok = c.claimed[p][i];
+		}
+		free(c.claimed[p]);
+	}
+	return ok;
+}
+
+static bool check_stmt(FlatChecker* c, FlatStmt* s) {
+	if (s->type > STMT_TYPE_LAST) return false;
+
+	switch ((StmtType)s->type) {
+		case STMT_STRUCT:
+			return check_index(c, POOL_TOKENS, s->struct_stmt.identifier, false) &&
+				   check_list(c, POOL_FIELDS, s->struct_stmt.fields);
+		case STMT_FUNC:
+			return check_index(c, POOL_DATA_TYPES, s->func.type, false) &&
+				   check_index(c, POOL_TOKENS, s->func.identifier, false) &&
+				   check_list(c, POOL_STMTS, s->func.params) &&
+				   check_list(c, POOL_STMTS, s->func.body);
+		case STMT_VAR_DECL:
+			return check_index(c, POOL_DATA_TYPES, s->var_decl.type, true) &&
+				   check_index(c, POOL_TOKENS, s->var_decl.identifier, false) &&
+				   check_index(c, POOL_EXPRS, s->var_decl.initializer, true);
+		case STMT_IF:
+			return check_index(c, POOL_BRANCHES, s->if_stmt.if_branch, false) &&
+				   check_list(c, POOL_BRANCHES, s->if_stmt.elif_branch) &&
+				   check_index(c, POOL_BRANCHES, s->if_stmt.else_branch, true);
+		case STMT_FOR:
+			return check_index(c, POOL_STMTS, s->for_stmt.counter, false) &&
+				   check_index(c, POOL_EXPRS, s->for_stmt.to, false) &&
+				   check_list(c, POOL_STMTS, s->for_stmt.body);
+		case STMT_WHILE:
+			return check_index(c, POOL_EXPRS, s->while_stmt.cond, false) &&
+				   check_list(c, POOL_STMTS, s->while_stmt.body);
+		case STMT_RETURN:
+			return check_index(c, POOL_EXPRS, s->return_stmt.expr, true) &&
+				   check_ref(c, s->return_stmt.function_referernced, STMT_FUNC, false) &&
+				   check_index(c, POOL_TOKENS, s->return_stmt.keyword, false);
+		case STMT_EXPR:
+			return check_index(c, POOL_EXPRS, s->expr, false);
+	}
+	return false;
+}
+
+static bool check_expr(FlatChecker* c, FlatExpr* x) {
+	if (x->type > EXPR_TYPE_LAST) return false;
+	if (!check_index(c, POOL_TOKENS, x->head, false)) return false;
+
+	switch ((ExprType)x->type) {
+		case EXPR_FUNC_CALL:
+		case EXPR_SET:
+		case EXPR_DEREF:
+		case EXPR_ADDR:
+		case EXPR_AT:
+		case EXPR_ARITHMETIC:
+		case EXPR_COMPARISON:
+			return check_index(c, POOL_TOKENS, x->func_call.callee, false) &&
+				   check_list(c, POOL_EXPRS, x->func_call.args) &&
+				   check_ref(c, x->func_call.function_called, STMT_FUNC, true);
+		case EXPR_VARIABLE:
+			return check_index(c, POOL_TOKENS, x->variable.identifier, false) &&
+				   check_ref(c, x->variable.variable_decl_referenced,
+							 STMT_VAR_DECL, true);
+		case EXPR_DOT_ACCESS:
+			return check_index(c, POOL_EXPRS, x->dot.left, false) &&
+				   check_index(c, POOL_TOKENS, x->dot.right, false);
+		case EXPR_NUMBER:
+		case EXPR_CHAR:
+		case EXPR_STRING:
+		case EXPR_BOOL:
+			return check_index(c, POOL_TOKENS, x->token, false);
+		case EXPR_NULL:
+			return true;
+	}
+	return false;
+}
+
+static bool check_index(FlatChecker* c, FlatPool pool, u32 idx, bool optional) {
+	if (idx == FLAT_NONE) return optional;
+	return idx < c->lens[pool];
+}
+
+static bool check_list(FlatChecker* c, FlatPool pool, FlatRange range) {
+	if ((u64)range.start + range.count > c->list_len) return false;
+
+	u32* indices = flat_list(c->ast, range);
+	for (u32 i = 0; i < range.count; ++i) {
+		if (!check_index(c, pool, indices[i], false)) return false;
+	}
+	return true;
+}
+
+/* a reference to a statement elsewhere in the tree, which does not make
+ * it a child */
+static bool check_ref(FlatChecker* c, u32 idx, StmtType type, bool optional) {
+	if (!check_index(c, POOL_STMTS, idx, optional)) return false;
+	return idx == FLAT_NONE || c->ast->stmts[idx].type == type;
+}
+
+/* the linker and resolve take a data type to be a struct name or one
+ * of the built-in types */
+static bool check_data_type_token(Token* t) {
+	return t->type == TOKEN_IDENTIFIER ||
+		   (t->type == TOKEN_KEYWORD &&
+			t->keyword >= KEYWORD_INT && t->keyword <= KEYWORD_VOID);
+}
+
+static bool claim_stmt_children(FlatChecker* c, u32 idx) {
+	FlatStmt* s = &c->ast->stmts[idx];
+	switch ((StmtType)s->type) {
+		case STMT_STRUCT: {
+			FlatRange fields = s->struct_stmt.fields;
+			for (u32 i = 0; i < fields.count; ++i) {
+				u32 field = flat_list(c->ast, fields)[i];
+				if (!claim(c, POOL_FIELDS, field, false) ||
+					!claim(c, POOL_DATA_TYPES, c->ast->fields[field].type, false)) {
+					return false;
+				}
+			}
+			return true;
+		}
+		case STMT_FUNC:
+			return claim(c, POOL_DATA_TYPES, s->func.type, false) &&
+				   claim_stmts(c, s->func.params, idx, PLACE_PARAM) &&
+				   claim_stmts(c, s->func.body, idx, PLACE_BODY);
+		case STMT_VAR_DECL:
+			return claim(c, POOL_DATA_TYPES, s->var_decl.type, true) &&
+				   claim_expr(c, s->var_decl.initializer, FLAT_NONE, true);
+		case STMT_IF: {
+			FlatRange elifs = s->if_stmt.elif_branch;
+			if (!claim_branch(c, s->if_stmt.if_branch, idx, true)) return false;
+			for (u32 i = 0; i < elifs.count; ++i) {
+				if (!claim_branch(c, flat_list(c->ast, elifs)[i], idx, true)) {
+					return false;
+				}
+			}
+			return s->if_stmt.else_branch == FLAT_NONE ||
+				   claim_branch(c, s->if_stmt.else_branch, idx, false);
+		}
+		case STMT_FOR:
+			return claim_stmt(c, s->for_stmt.counter, idx, PLACE_COUNTER) &&
+				   claim_expr(c, s->for_stmt.to, FLAT_NONE, false) &&
+				   claim_stmts(c, s->for_stmt.body, idx, PLACE_BODY);
+		case STMT_WHILE:
+			return claim_expr(c, s->while_stmt.cond, FLAT_NONE, false) &&
+				   claim_stmts(c, s->while_stmt.body, idx, PLACE_BODY);
+		case STMT_RETURN:
+			return claim_expr(c, s->return_stmt.expr, FLAT_NONE, true);
+		case STMT_EXPR:
+			return claim_expr(c, s->expr, FLAT_NONE, false);
+	}
+	return false;
+}
+
+static bool claim_expr_children(FlatChecker* c, u32 idx) {
+	FlatExpr* x = &c->ast->exprs[idx];
+	switch ((ExprType)x->type) {
+		case EXPR_FUNC_CALL:
+		case EXPR_SET:
+		case EXPR_DEREF:
+		case EXPR_ADDR:
+		case EXPR_AT:
+		case EXPR_ARITHMETIC:
+		case EXPR_COMPARISON: {
+			FlatRange args = x->func_call.args;
+			for (u32 i = 0; i < args.count; ++i) {
+				if (!claim_expr(c, flat_list(c->ast, args)[i], idx, false)) {
+					return false;
+				}
+			}
+			return true;
+		}
+		case EXPR_DOT_ACCESS:
+			return claim_expr(c, x->dot.left, idx, false);
+		default: break;
+	}
+	return true;
+}
+
+static bool claim_stmts(FlatChecker* c, FlatRange range, u32 parent,
+						StmtPlace place) {
+	for (u32 i = 0; i < range.count; ++i) {
+		if (!claim_stmt(c, flat_list(c->ast, range)[i], parent, place)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool claim_stmt(FlatChecker* c, u32 idx, u32 parent, StmtPlace place) {
+	if (parent != FLAT_NONE && idx <= parent) return false;
+	if (!claim(c, POOL_STMTS, idx, false)) return false;
+
+	FlatStmt* s = &c->ast->stmts[idx];
+	switch (place) {
+		case PLACE_TOP_LEVEL:
+			return s->type == STMT_STRUCT || s->type == STMT_FUNC ||
+				   (s->type == STMT_VAR_DECL && s->var_decl.type != FLAT_NONE);
+		case PLACE_BODY:
+			return s->type != STMT_STRUCT && s->type != STMT_FUNC &&
+				   (s->type != STMT_VAR_DECL || s->var_decl.type != FLAT_NONE);
+		case PLACE_PARAM:
+			return s->type == STMT_VAR_DECL && s->var_decl.type != FLAT_NONE;
+		case PLACE_COUNTER:
+			return s->type == STMT_VAR_DECL;
+	}
+	return false;
+}
+
+/* the body of a branch belongs to the 'if' statement 'parent' */
+static bool claim_branch(FlatChecker* c, u32 idx, u32 parent, bool needs_cond) {
+	if (!claim(c, POOL_BRANCHES, idx, false)) return false;
+
+	FlatIfBranch* b = &c->ast->branches[idx];
+	if (needs_cond && b->cond == FLAT_NONE) return false;
+	return claim_expr(c, b->cond, FLAT_NONE, true) &&
+		   claim_stmts(c, b->body, parent, PLACE_BODY);
+}
+
+/* 'parent' is FLAT_NONE for the root of an expression */
+static bool claim_expr(FlatChecker* c, u32 idx, u32 parent, bool optional) {
+	if (idx != FLAT_NONE && parent != FLAT_NONE && idx <= parent) return false;
+	return claim(c, POOL_EXPRS, idx, optional);
+}
+
+static bool claim(FlatChecker* c, FlatPool pool, u32 idx, bool optional) {
+	if (idx == FLAT_NONE) return optional;
+	if (c->claimed[pool][idx]) return false;
+	c->claimed[pool][idx] = true;
+	return true;
+}
@@ -58,10 +58,37 @@ typedef struct {
 							(b)[buf__hdr(b)->len++] = (__VA_ARGS__))
 #define buf_pop(b)		   ((b) ? buf__shrink((b), 1) : 0)
 #define buf_printf(b, ...) ((b) = buf__printf((b), __VA_ARGS__))
+#define buf_vprintf(b, fmt, ap) ((b) = buf__vprintf((b), (fmt), (ap)))
 #define buf_clear(b)	   ((b) ? buf__hdr(b)->len = 0 : 0)
 
 void* buf__grow(const void* buf, u64 new_len, u64 elem_size);
 void buf__shrink(const void* buf, u64 size);
+char* buf__printf(char* buf, const char* fmt, ...);
+char* buf__vprintf(char* buf, const char* fmt, va_list ap);
+
+typedef struct {
+	char* ptr;
+	char* end;
+	char** blocks;
+} Arena;
+
+void* arena_alloc(Arena* arena, u64 size);
+void* arena_buf_alloc(Arena* arena, u64 len, u64 elem_size);
+void* arena_buf_copy(Arena* arena, const void* elems, u64 len, u64 elem_size);
+void arena_merge(Arena* arena, Arena* other);
+void arena_free(Arena* arena);
+
+typedef struct {
+	u64* keys;
+	u64* values;
+	u64 len;
+	u64 cap;
+} Map;
+
+/* map_get returns 0 for missing keys */
+u64 map_get(Map* map, u64 key);
+void map_put(Map* map, u64 key, u64 value);
+void map_free(Map* map);
 
 typedef char echar;
 
@@ -74,28 +101,65 @@ echar* estr_sub(echar* estr, u64 start, u64 end);
 typedef struct {
 	char* fpath;
 	char* contents;
-	uint len;
+	u64 len;
+	u64 map_len; /* non-zero if contents is memory-mapped */
+	u64* line_offsets; /* built on first use by get_line_at, from any thread */
 } SourceFile;
 
 SourceFile* ether_read_file(char* fpath);
+void ether_close_file(SourceFile* file);
 char* get_line_at(SourceFile* file, u64 line);
+u64 get_offset_at(SourceFile* file, u64 line, u32 column);
+void get_position_at(SourceFile* file, u64 offset, u64* out_line, u32* out_column);
+void get_position_from(SourceFile* file, u64 offset, u64* io_line, u32* out_column);
+
+/* replaces 'removed_len' bytes at 'offset' with 'inserted' */
+typedef struct {
+	u64 offset;
+	u64 removed_len;
+	char* inserted;
+	u64 inserted_len;
+} SourceEdit;
+
+SourceFile* source_file_apply_edit(SourceFile* file, SourceEdit* edit);
 
-error_code print_file_line(SourceFile* file, u64 line);
-error_code print_file_line_with_info(SourceFile* file, u64 line);
+error_code format_file_line(char** out, SourceFile* file, u64 line);
+error_code format_file_line_with_info(char** out, SourceFile* file, u64 line);
 
-error_code print_marker_arrow_ln(SourceFile* file, u64 line, u32 column);
-error_code print_marker_arrow_with_info_ln(SourceFile* file,
-										   u64 line, u32 column);
+error_code format_marker_arrow_ln(char** out, SourceFile* file,
+								  u64 line, u32 column);
+error_code format_marker_arrow_with_info_ln(char** out, SourceFile* file,
+											u64 line, u32 column);
 
 void ether_error(const char* fmt, ...);
 
+typedef enum {
+	DIAG_ERROR,
+	DIAG_WARNING,
+	DIAG_NOTE,
+} DiagLevel;
+
+void diag_report(DiagLevel level, SourceFile* file, u64 line, u32 column,
+				 const char* fmt, ...);
+void diag_vreport(DiagLevel level, SourceFile* file, u64 line, u32 column,
+				  const char* fmt, va_list ap);
+void diag_message(const char* fmt, ...);
+void diag_defer(bool on);
+void diag_flush_deferred(bool write);
+
 typedef struct {
 	u64 len;
+	u64 hash;
 	char* str;
 } Intern;
 
 char* str_intern_range(char* start, char* end);
 char* str_intern(char* str);
+/* interned strings are numbered densely from 1 in the order they are
+ * first interned, so that passes can index arrays by symbol */
+u32 str_symbol(char* interned);
+/* one more than the largest symbol handed out so far */
+u32 str_symbol_count(void);
 
 #define ETHER_ERROR true
 #define ETHER_SUCCESS false
@@ -130,31 +194,126 @@ typedef enum {
 	TOKEN_EOF,
 } TokenType;
 
+/* the last member of each kind enum, for reading kinds back from a file */
+#define TOKEN_TYPE_LAST TOKEN_EOF
+
+/* keep the built-in data types (KEYWORD_INT..KEYWORD_VOID) and the
+ * operator keywords (KEYWORD_SET..KEYWORD_AT) contiguous; the parser
+ * checks them as ranges */
+typedef enum {
+	KEYWORD_NONE,
+
+	KEYWORD_STRUCT,
+	KEYWORD_DEFN,
+	KEYWORD_DECL,
+	KEYWORD_PUB,
+	KEYWORD_LOAD,
+	KEYWORD_LET,
+	KEYWORD_EXTERN,
+	KEYWORD_IF,
+	KEYWORD_ELIF,
+	KEYWORD_ELSE,
+	KEYWORD_FOR,
+	KEYWORD_WHILE,
+	KEYWORD_TO,
+	KEYWORD_RETURN,
+
+	KEYWORD_SET,
+	KEYWORD_DEREF,
+	KEYWORD_ADDR,
+	KEYWORD_AT,
+
+	KEYWORD_INT,
+	KEYWORD_I8,
+	KEYWORD_I16,
+	KEYWORD_I32,
+	KEYWORD_I64,
+	KEYWORD_U8,
+	KEYWORD_U16,
+	KEYWORD_U32,
+	KEYWORD_U64,
+	KEYWORD_CHAR,
+	KEYWORD_BOOL,
+	KEYWORD_VOID,
+
+	KEYWORD_NULL,
+	KEYWORD_TRUE,
+	KEYWORD_FALSE,
+} KeywordType;
+
+#define KEYWORD_TYPE_LAST KEYWORD_FALSE
+
 typedef struct {
 	TokenType type;
+	KeywordType keyword;
 	char* lexeme;
 	SourceFile* srcfile;
 	u64 line;
 	u32 column;
+	u32 symbol; /* str_symbol(lexeme), 0 for none */
 } Token;
 
+/* tokens are stored as parallel arrays carved out of one allocation,
+ * one row per token: type, keyword, interned lexeme and byte offset.
+ * lines and columns are not stored; token_store_get derives them from
+ * the offset when a full Token record is needed. */
+typedef struct {
+	TokenType* types;
+	KeywordType* keywords;
+	char** lexemes;
+	u64* offsets;
+	u64 len;
+	u64 cap;
+} TokenStore;
+
+void token_store_push(TokenStore* store, TokenType type, KeywordType keyword,
+					  char* lexeme, u64 offset);
+Token token_store_get(TokenStore* store, SourceFile* file, u64 idx);
+Token token_store_get_from(TokenStore* store, SourceFile* file, u64 idx,
+						   u64* io_line);
+void token_store_free(TokenStore* store);
+
+char* scan_whitespace(char* cur, char* end);
+char* scan_identifier(char* cur, char* end);
+char* scan_line_end(char* cur, char* end);
+char* scan_string_end(char* cur, char* end);
+
 typedef struct {
 	SourceFile* srcfile;
-	Token** tokens;
-	char** keywords;
+	TokenStore tokens;
 
-	char* start, *cur;
+	char* start, *cur, *end;
 	u64 line;
 	char* last_newline;
-	char* last_to_last_newline;
+	u64 token_line; /* line of the last token lexer_next handed out */
 
 	uint error_count;
 	error_code error_occured;
+	bool quiet; /* count errors without printing them */
 } Lexer;
 
 bool is_token_identical(Token* a, Token* b);
+KeywordType lookup_keyword(char* start, u64 len);
+
+TokenStore* lexer_run(Lexer* lexer, SourceFile* file, error_code* out_error_code);
+void lexer_start(Lexer* lexer, SourceFile* file);
+void lexer_start_range(Lexer* lexer, SourceFile* file,
+					   char* start, char* end, u64 line);
+bool lexer_range_complete(Lexer* lexer);
+char* lexer_find_split(char* cur, char* end);
+Token lexer_next(Lexer* lexer);
+
+/* tokens [first, first + old_count) of the old store were replaced by
+ * tokens [first, first + new_count) of the new one */
+typedef struct {
+	u64 first;
+	u64 old_count;
+	u64 new_count;
+} TokenRange;
 
-Token** lexer_run(Lexer* lexer, SourceFile* file, error_code* out_error_code);
+TokenStore* lexer_relex(Lexer* lexer, SourceFile* file, TokenStore* old_tokens,
+						SourceEdit* edit, TokenRange* out_changed,
+						error_code* out_error_code);
 
 typedef enum {
 	EXPR_NUMBER,
@@ -164,9 +323,19 @@ typedef enum {
 	EXPR_BOOL,
 	EXPR_VARIABLE,
 	EXPR_FUNC_CALL,
+	/* the built-in operators have the shape of a call: 'func_call.callee'
+	 * is the operator and 'func_call.args' are its operands */
+	EXPR_SET,
+	EXPR_DEREF,
+	EXPR_ADDR,
+	EXPR_AT,
+	EXPR_ARITHMETIC,
+	EXPR_COMPARISON,
 	EXPR_DOT_ACCESS,
 } ExprType;
 
+#define EXPR_TYPE_LAST EXPR_DOT_ACCESS
+
 typedef struct Expr Expr;
 typedef struct Stmt Stmt;
 
@@ -217,6 +386,8 @@ typedef enum {
 	STMT_EXPR,
 } StmtType;
 
+#define STMT_TYPE_LAST STMT_EXPR
+
 typedef struct {
 	DataType* type;
 	Token* identifier;
@@ -293,15 +464,26 @@ struct Stmt {
 	};
 };
 
+/* must be a power of two */
+#define PARSER_WINDOW_SIZE 8
+
+typedef struct {
+	Token* token;
+	char* msg;
+} DeferredWarning;
+
+typedef struct ExprFrame ExprFrame;
+
 typedef struct {
-	Token** tokens;
-	u64 tokens_len;
+	Lexer* lexer;
+	Token window[PARSER_WINDOW_SIZE];
+	u64 lexed;
+	Arena* arena;
+	void** scratch;
+	ExprFrame* expr_frames; /* open calls while parsing an expression */
 	Stmt** stmts;
 	SourceFile* srcfile;
 
-	char** built_in_data_types;
-	char** operator_keywords;
-
 	u64 idx;
 	uint error_count;
 	bool error_occured;
@@ -309,9 +491,25 @@ typedef struct {
 	bool error_panic;
 	bool start_stmt_bracket;
 	Stmt* current_function;
+
+	/* errors are counted but not printed, warnings are kept in
+	 * 'warnings' for whoever runs the parser to report */
+	bool quiet;
+	DeferredWarning* warnings;
+	uint warning_count;
+
+	/* the path token of every 'load', in source order; owned by
+	 * whoever runs the parser */
+	Token** loads;
 } Parser;
 
-Stmt** parser_run(Parser* parser, Token** tokens,
+/* files big enough are split and their chunks lexed and parsed on up
+ * to this many threads */
+void parser_set_thread_count(uint count);
+uint parser_thread_count(void);
+/* every node, list and token of the returned tree lives in 'arena';
+ * the lists are stretchy buffers that must not be grown or freed */
+Stmt** parser_run(Parser* parser, Lexer* lexer, Arena* arena,
 				  SourceFile* file, error_code* out_error_code);
 
 #ifdef _DEBUG
@@ -322,40 +520,236 @@ Stmt** parser_run(Parser* parser, Token** tokens,
 
 void print_ast_debug(Stmt** stmts);
 
-typedef struct Scope {
-	Stmt** variables;
-	struct Scope* parent_scope;
-} Scope;
+/* compact form of the tree, which is what the ast cache stores: nodes
+ * live in typed pools and refer to each other, and to tokens, by 32-bit
+ * index. child lists are
+ * (start, count) ranges into 'lists', whose entries index the pool
+ * the list belongs to. FLAT_NONE marks a missing node. */
+#define FLAT_NONE ((u32)0xffffffff)
+
+typedef struct {
+	u32 start;
+	u32 count;
+} FlatRange;
+
+#define flat_list(ast, range) ((ast)->lists + (range).start)
+
+typedef struct {
+	u32 type;
+	u8 pointer_count;
+} FlatDataType;
+
+typedef struct {
+	u32 callee;
+	FlatRange args;
+	u32 function_called;
+} FlatFuncCall;
+
+typedef struct {
+	u32 identifier;
+	u32 variable_decl_referenced;
+} FlatVariableRef;
+
+typedef struct {
+	u32 left;
+	u32 right;
+	bool is_left_pointer;
+} FlatDotAccess;
+
+typedef struct {
+	u8 type; /* ExprType */
+	u32 head;
+	union {
+		FlatFuncCall func_call;
+		FlatVariableRef variable;
+		FlatDotAccess dot;
+		u32 token; /* number, chr, string and boolean */
+	};
+} FlatExpr;
+
+typedef struct {
+	u32 type;
+	u32 identifier;
+	u32 struct_referenced;
+} FlatField;
+
+typedef struct {
+	u32 identifier;
+	FlatRange fields;
+} FlatStruct;
+
+typedef struct {
+	u32 type;
+	u32 identifier;
+	FlatRange params;
+	FlatRange body;
+	bool is_function;
+	bool public;
+} FlatFunc;
+
+typedef struct {
+	u32 type;
+	u32 identifier;
+	u32 initializer;
+	bool is_global_var;
+	bool is_variable;
+} FlatVarDecl;
+
+typedef struct {
+	u32 cond;
+	FlatRange body;
+} FlatIfBranch;
+
+typedef struct {
+	u32 if_branch;
+	FlatRange elif_branch;
+	u32 else_branch;
+} FlatIf;
+
+typedef struct {
+	u32 counter;
+	u32 to;
+	FlatRange body;
+} FlatFor;
+
+typedef struct {
+	u32 cond;
+	FlatRange body;
+} FlatWhile;
+
+typedef struct {
+	u32 expr;
+	u32 function_referernced;
+	u32 keyword;
+} FlatReturn;
+
+typedef struct {
+	u8 type; /* StmtType */
+	union {
+		FlatStruct struct_stmt;
+		FlatFunc func;
+		FlatVarDecl var_decl;
+		FlatIf if_stmt;
+		FlatFor for_stmt;
+		FlatWhile while_stmt;
+		FlatReturn return_stmt;
+		u32 expr;
+	};
+} FlatStmt;
+
+typedef struct {
+	FlatStmt* stmts;
+	FlatExpr* exprs;
+	FlatDataType* data_types;
+	FlatField* fields;
+	FlatIfBranch* branches;
+	u32* lists;
+	Token* tokens;
+	FlatRange top_level;
+} FlatAst;
+
+void flat_ast_build(FlatAst* ast, Stmt** stmts);
+/* rebuilds the pointer tree in 'arena'; the tree points into
+ * 'ast->tokens', which has to be allocated from 'arena' as well */
+Stmt** flat_ast_expand(FlatAst* ast, Arena* arena);
+/* true if 'ast' has the shape of a tree flat_ast_build makes, so that
+ * it can be expanded and walked; anything read from a file has to pass
+ * this first */
+bool flat_ast_check(FlatAst* ast);
+void flat_ast_free(FlatAst* ast);
+
+/* a variable in scope; 'shadowed' is the index + 1 of the
+ * declaration of the same name it hides, 0 if it hides none */
+typedef struct {
+	Stmt* var;
+	u64 shadowed;
+} ScopeVariable;
 
 void token_error(bool* error_occured, uint* error_count,
 				 Token* t, const char* fmt, ...);
 void token_warning(Token* t, const char* fmt, ...);
 void token_note(Token* token, const char* fmt, ...);
 
-void linker_init(Stmt** p_stmts);
-Stmt** linker_run(error_code* err_code);
-
+/* declares the top-level names and returns the structs, in order of
+ * definition, which stay valid until linker_destroy; the rest is
+ * linked by the link_* hooks as resolve_run walks the tree */
+Stmt** linker_init(Stmt** p_stmts);
+bool linker_error_occured(void);
+void linker_destroy(void);
+void link_stmt(Stmt* stmt);
+void link_stmt_end(Stmt* stmt);
+void link_if_branch(void);
+void link_if_branch_end(void);
+bool link_expr(Expr* expr);
+void link_expr_tree(Expr* root);
+
+/* built-in types, KEYWORD_INT..KEYWORD_VOID */
 typedef struct {
-	char* a;
-	char* b;
+	KeywordType a;
+	KeywordType b;
 } ImplicitCastTypeMap;
 
-typedef struct {
-	char* type;
-	u64 size;
-} TypeSizeMap;
-
 void resolve_init(Stmt** p_stmts, Stmt** p_structs);
 error_code resolve_run(void);
 
 void code_gen_init(Stmt** p_stmts, SourceFile* p_srcfile);
 void code_gen_run(void);
 
+typedef enum {
+	MODULE_LOADING,
+	MODULE_LOADED,
+	MODULE_FAILED,
+} ModuleState;
+
+typedef struct Module Module;
+
+/* a source file, lexed and parsed once no matter how many files load it */
+struct Module {
+	char* fpath; /* canonical, interned */
+	u64 hash; /* of the contents */
+	SourceFile* srcfile;
+	Stmt** stmts;
+	Token** loads; /* the path token of every 'load' */
+	Module** deps; /* the modules this one loads, in source order */
+	ModuleState state;
+	bool unsaved; /* parsed in this run, still to be written to the cache */
+};
+
 typedef struct {
-	char* fpath;
-	char* obj_fpath;
+	Module* module;
+	Token* load; /* the 'load' that started it, null for the root */
+} LoadFrame;
+
+typedef struct {
+	char* cache_dir; /* null if parsed modules are not cached */
+	Arena arena; /* the trees of every module */
+	Map modules; /* canonical path -> Module* */
+	Module** order; /* loaded modules, each after the ones it loads */
+	LoadFrame* loading; /* modules still being loaded, innermost last */
+	bool error_occured;
 } Loader;
 
-error_code loader_load(Loader* loader, char* fpath, char* obj_fpath);
+void loader_init(Loader* loader, char* cache_dir);
+/* loads 'file' and, transitively, every file it loads; the loader
+ * takes ownership of 'file' */
+Module* loader_load(Loader* loader, SourceFile* file, error_code* out_error_code);
+/* the statements of all loaded modules, in 'order', allocated from
+ * the loader's arena */
+Stmt** loader_stmts(Loader* loader);
+/* writes the modules that were parsed in this run to the cache; only
+ * meant to be called once the program passed the linker and resolve */
+void loader_save_cache(Loader* loader);
+void loader_free(Loader* loader);
+
+/* bump whenever the file format changes; a cache is also tied to the
+ * compiler binary that wrote it, see build_id in ast_cache.c */
+#define AST_CACHE_VERSION 3
+
+/* a module's parsed tree, cached under the hash of its source; it
+ * stands in for lexing and parsing only */
+bool ast_cache_read(char* cache_dir, SourceFile* file, u64 hash, Arena* arena,
+					Stmt*** out_stmts, Token*** out_loads);
+error_code ast_cache_write(char* cache_dir, SourceFile* file, u64 hash,
+						   FlatAst* ast, Token** loads);
 
 #endif
@@ -1,90 +1,295 @@
+#define _DEFAULT_SOURCE
 #include <ether/ether.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
 
-static void print_tab(void);
+#define READ_CHUNK_SIZE (64 * 1024)
+#define POSITION_SCAN_MAX 8
 
+static pthread_mutex_t line_index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char* map_file(int, u64, u64*);
+static char* read_stream(int, u64*);
+static u64* line_index(SourceFile*);
+static u64* build_line_index(SourceFile*);
+static void format_tab(char**);
+
+/* regular files are mapped read-only; anything else (pipes, character
+ * devices, empty files) is streamed into a heap buffer. either way
+ * contents[len] is guaranteed to be '\0'. a path of "-" reads standard
+ * input, which is left open. */
 SourceFile* ether_read_file(char* fpath) {
-	/* TODO: more thorough error checking */
-	FILE* fp = fopen(fpath, "r");
-	if (!fp) return null;
-	fseek(fp, 0, SEEK_END);
-	uint size = ftell(fp);
-	rewind(fp);
+	bool is_stdin = (strcmp(fpath, "-") == 0);
+	int fd = (is_stdin ? STDIN_FILENO : open(fpath, O_RDONLY));
+	if (fd == -1) return null;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		if (!is_stdin) close(fd);
+		return null;
+	}
 
-	char* contents = (char*)malloc(size + 1);
-	fread((void*)contents, sizeof(char), size, fp);
-	fclose(fp);
+	char* contents = null;
+	u64 len = 0;
+	u64 map_len = 0;
+	if (S_ISREG(st.st_mode) && st.st_size > 0) {
+		len = (u64)st.st_size;
+		contents = map_file(fd, len, &map_len);
+	}
+	if (!contents) {
+		map_len = 0;
+		contents = read_stream(fd, &len);
+	}
+	if (!is_stdin) close(fd);
+	if (!contents) return null;
 
 	SourceFile* file = (SourceFile*)malloc(sizeof(SourceFile));
+	if (!file) {
+		if (map_len) munmap(contents, map_len);
+		else free(contents);
+		return null;
+	}
 	file->fpath = fpath;
 	file->contents = contents;
-	file->len = size;
+	file->len = len;
+	file->map_len = map_len;
+	file->line_offsets = null;
 	return file;
 }
 
+void ether_close_file(SourceFile* file) {
+	if (file->map_len) {
+		munmap(file->contents, file->map_len);
+	}
+	else {
+		free(file->contents);
+	}
+	buf_free(file->line_offsets);
+	free(file);
+}
+
+SourceFile* source_file_apply_edit(SourceFile* file, SourceEdit* edit) {
+	assert(edit->offset + edit->removed_len <= file->len);
+	u64 tail_offset = edit->offset + edit->removed_len;
+	u64 tail_len = file->len - tail_offset;
+	u64 len = edit->offset + edit->inserted_len + tail_len;
+
+	char* contents = (char*)malloc(len + 1);
+	memcpy(contents, file->contents, edit->offset);
+	memcpy(contents + edit->offset, edit->inserted, edit->inserted_len);
+	memcpy(contents + edit->offset + edit->inserted_len,
+		   file->contents + tail_offset, tail_len);
+	contents[len] = '\0';
+
+	SourceFile* new = (SourceFile*)malloc(sizeof(SourceFile));
+	new->fpath = file->fpath;
+	new->contents = contents;
+	new->len = len;
+	new->map_len = 0;
+	new->line_offsets = null;
+	return new;
+}
+
+/* reserves one zero page more than the file needs and maps the file
+ * over the start of it. the bytes between the end of the file and the
+ * end of its last page are zero-filled by the kernel, and the extra
+ * page covers files whose size is a multiple of the page size. */
+static char* map_file(int fd, u64 len, u64* out_map_len) {
+	u64 page_size = (u64)sysconf(_SC_PAGESIZE);
+	u64 file_pages_len = (len + page_size - 1) & ~(page_size - 1);
+	u64 map_len = file_pages_len + page_size;
+
+	char* base = (char*)mmap(null, map_len, PROT_READ,
+							 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) return null;
+
+	char* contents = (char*)mmap(base, file_pages_len, PROT_READ,
+								 MAP_PRIVATE | MAP_FIXED, fd, 0);
+	if (contents == MAP_FAILED) {
+		munmap(base, map_len);
+		return null;
+	}
+
+	*out_map_len = map_len;
+	return contents;
+}
+
+/* a read interrupted by a signal, which pipes and terminals are prone
+ * to, is retried; any other failure gives null */
+static char* read_stream(int fd, u64* out_len) {
+	u64 len = 0;
+	u64 cap = READ_CHUNK_SIZE;
+	char* contents = (char*)malloc(cap + 1);
+	if (!contents) return null;
+
+	for (;;) {
+		if (len == cap) {
+			char* grown = (char*)realloc(contents, cap * 2 + 1);
+			if (!grown) {
+				free(contents);
+				return null;
+			}
+			contents = grown;
+			cap *= 2;
+		}
+
+		ssize_t bytes_read = read(fd, contents + len, cap - len);
+		if (bytes_read == 0) break;
+		if (bytes_read == -1) {
+			if (errno == EINTR) continue;
+			free(contents);
+			return null;
+		}
+		len += (u64)bytes_read;
+	}
+
+	contents[len] = '\0';
+	*out_len = len;
+	return contents;
+}
+
 char* get_line_at(SourceFile* file, u64 line) {
 	assert(line != 0);
 	assert(file->contents);
 
-	const u64 target_newline = line - 1;
-	u64 newline_count = 0;
-	char* line_to_print = file->contents;
+	u64* line_offsets = line_index(file);
+	if (line > buf_len(line_offsets)) {
+		return null;
+	}
+	return file->contents + line_offsets[line - 1];
+}
+
+u64 get_offset_at(SourceFile* file, u64 line, u32 column) {
+	char* line_start = get_line_at(file, line);
+	assert(line_start);
+	assert(column != 0);
+	return (line_start - file->contents) + column - 1;
+}
+
+/* the line and column of byte 'offset', by binary search over the line
+ * starts */
+void get_position_at(SourceFile* file, u64 offset, u64* out_line, u32* out_column) {
+	u64* line_offsets = line_index(file);
+	u64 lo = 0;
+	u64 hi = buf_len(line_offsets);
+	while (hi - lo > 1) {
+		u64 mid = lo + (hi - lo) / 2;
+		if (line_offsets[mid] <= offset) lo = mid;
+		else hi = mid;
+	}
+	*out_line = lo + 1;
+	*out_column = (u32)(offset - line_offsets[lo] + 1);
+}
+
+/* the same for an offset that is usually on line '*io_line' or a few
+ * lines after it, as when offsets come in increasing order; the line
+ * found is stored back into '*io_line' */
+void get_position_from(SourceFile* file, u64 offset, u64* io_line, u32* out_column) {
+	u64* line_offsets = line_index(file);
+	u64 line_count = buf_len(line_offsets);
+	u64 line = *io_line;
+	if (line == 0 || line > line_count || line_offsets[line - 1] > offset) {
+		get_position_at(file, offset, io_line, out_column);
+		return;
+	}
 
-	while (newline_count < target_newline) {
-		while (*line_to_print != '\n') {
-			if (*line_to_print == '\0') return null;
-			++line_to_print;
+	for (uint steps = 0; line < line_count && line_offsets[line] <= offset; ++steps) {
+		if (steps == POSITION_SCAN_MAX) {
+			get_position_at(file, offset, io_line, out_column);
+			return;
 		}
-		++line_to_print;
-		++newline_count;
+		++line;
+	}
+	*io_line = line;
+	*out_column = (u32)(offset - line_offsets[line - 1] + 1);
+}
+
+/* diagnostics can be reported from any thread, so the index is built
+ * under a lock by whichever thread needs it first. once it is
+ * published it never changes, and later lookups skip the lock. */
+static u64* line_index(SourceFile* file) {
+	u64* line_offsets = __atomic_load_n(&file->line_offsets, __ATOMIC_ACQUIRE);
+	if (line_offsets) return line_offsets;
+
+	pthread_mutex_lock(&line_index_lock);
+	line_offsets = file->line_offsets;
+	if (!line_offsets) {
+		line_offsets = build_line_index(file);
+		__atomic_store_n(&file->line_offsets, line_offsets, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&line_index_lock);
+	return line_offsets;
+}
+
+/* records the offset of every line start. scan_line_end also stops at
+ * an embedded '\0', but the lexer keeps counting lines past one, so
+ * the index does too. */
+static u64* build_line_index(SourceFile* file) {
+	char* end = file->contents + file->len;
+	char* cur = file->contents;
+	u64* line_offsets = null;
+
+	buf_push(line_offsets, 0);
+	for (;;) {
+		cur = scan_line_end(cur, end);
+		if (cur >= end) break;
+		if (*cur++ == '\n') buf_push(line_offsets, cur - file->contents);
 	}
-	return line_to_print;
+	return line_offsets;
 }
 
-error_code print_file_line(SourceFile* file, u64 line) {
+/* the format_* functions append to a stretchy char buffer, so that a
+ * whole diagnostic can be written out at once */
+error_code format_file_line(char** out, SourceFile* file, u64 line) {
 	assert(line != 0);
 
 	char* line_to_print = get_line_at(file, line);
 	assert(line_to_print);
+	char* line_end = scan_line_end(line_to_print, file->contents + file->len);
 
-	while (*line_to_print != '\n') {
-		if (*line_to_print == '\0') break;
-
-		if (*line_to_print == '\t') print_tab();
-		else printf("%c", *line_to_print);
+	while (line_to_print != line_end) {
+		if (*line_to_print == '\t') format_tab(out);
+		else buf_push(*out, *line_to_print);
 		++line_to_print;
 	}
-	printf("\n");
+	buf_push(*out, '\n');
 	return ETHER_SUCCESS;
 }
 
-error_code print_file_line_with_info(SourceFile* file, u64 line) {
-	printf("%6ld | ", line);
-	return print_file_line(file, line);
+error_code format_file_line_with_info(char** out, SourceFile* file, u64 line) {
+	buf_printf(*out, "%6ld | ", line);
+	return format_file_line(out, file, line);
 }
 
-error_code print_marker_arrow_ln(SourceFile* file, u64 line, u32 column) {
+error_code format_marker_arrow_ln(char** out, SourceFile* file,
+								  u64 line, u32 column) {
 	char* whitespace_start = get_line_at(file, line);
 	assert(whitespace_start);
-	const char* marker = whitespace_start + column - 1;
+	const char* marker = file->contents + get_offset_at(file, line, column);
 
 	while (whitespace_start != marker) {
 		if (*whitespace_start == '\0') return ETHER_ERROR;
-		if (*whitespace_start == '\t') print_tab();
-		else printf(" ");
+		if (*whitespace_start == '\t') format_tab(out);
+		else buf_push(*out, ' ');
 		++whitespace_start;
 	}
-	printf("^\n");
+	buf_push(*out, '^');
+	buf_push(*out, '\n');
 	return ETHER_SUCCESS;
 }
 
-error_code print_marker_arrow_with_info_ln(SourceFile* file,
-										   u64 line, u32 column) {
-	printf("%6s | ", "");
-	return print_marker_arrow_ln(file, line, column);
+error_code format_marker_arrow_with_info_ln(char** out, SourceFile* file,
+											u64 line, u32 column) {
+	buf_printf(*out, "%6s | ", "");
+	return format_marker_arrow_ln(out, file, line, column);
 }
 
-static void print_tab(void) {
+static void format_tab(char** out) {
 	for (u8 i = 0; i < TAB_SIZE; ++i) {
-		printf(" ");
+		buf_push(*out, ' ');
 	}
 }
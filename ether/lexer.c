@@ -1,13 +1,18 @@
 #include <ether/ether.h>
 
-static void lexer_destroy(Lexer*);
-
+static void lexer_init(Lexer*, SourceFile*);
+static void lex_once(Lexer*);
 static void lex_identifier(Lexer*);
+static void restart_at_line_of(Lexer*, u64);
+static bool has_newline(char*);
+static u64 last_token_before(TokenStore*, u64);
+static bool find_token_at(TokenStore*, u64, u64*);
 static void lex_number(Lexer*);
 static void lex_string(Lexer*);
 static void lex_char(Lexer*);
 static void lex_comment(Lexer*);
 static void lex_newline(Lexer*);
+static void count_newlines(Lexer*, char*, char*);
 
 static void add_token(Lexer*, TokenType);
 static void add_eof(Lexer*);
@@ -17,135 +22,317 @@ static bool is_at_end(Lexer*);
 static u32 get_column(Lexer*);
 static void error_at_current(Lexer*, const char*, ...);
 
-static void init_keywords(Lexer*);
-
-Token** lexer_run(Lexer* l, SourceFile* file, error_code* out_error_code) {
+static void lexer_init(Lexer* l, SourceFile* file) {
 	l->srcfile = file;
-	l->tokens = null;
+	l->tokens = (TokenStore){ 0 };
 	l->start = l->srcfile->contents;
 	l->cur = l->srcfile->contents;
+	l->end = l->srcfile->contents + l->srcfile->len;
 	l->line = 1;
 	l->error_count = 0;
 	l->error_occured = false;
 	l->last_newline = l->srcfile->contents;
-	l->last_to_last_newline = null;
-	l->keywords = null;
-
-	init_keywords(l);
-
-	for (l->cur = l->srcfile->contents; l->cur != (l->srcfile->contents + l->srcfile->len);) {
-		l->start = l->cur;
-		switch (*l->cur) {
-			case ':': add_token(l, TOKEN_COLON); break;
-			case '+': add_token(l, TOKEN_PLUS);  break;
-			case '-': add_token(l, TOKEN_MINUS); break;
-			case '*': add_token(l, TOKEN_STAR);  break;
-			case '/': add_token(l, TOKEN_SLASH); break;
-			case '%': add_token(l, TOKEN_PERCENT); break;
-			case '[': add_token(l, TOKEN_LEFT_BRACKET); break;
-			case ']': add_token(l, TOKEN_RIGHT_BRACKET); break;
-			case '=': add_token(l, TOKEN_EQUAL); break;
-			case ',': add_token(l, TOKEN_COMMA); break;
-			case '.': add_token(l, TOKEN_DOT); break;
-			case '<': match_char(l, '=') ? add_token(l, TOKEN_LESS_EQUAL) : add_token(l, TOKEN_LESS); break;
-			case '>': match_char(l, '=') ? add_token(l, TOKEN_GREATER_EQUAL) : add_token(l, TOKEN_GREATER); break;
-				
-			case '"':  lex_string(l); break;
-			case '\'': lex_char(l); break;	
-			case '\n': lex_newline(l); break;
-
-			case '\t':
-			case '\r':
-			case ' ': ++l->cur; break;
-
-			case ';': {
-				if (match_char(l, ';')) {
-					lex_comment(l);
-				}
-				else {
-					error_at_current(l, "invalid semicolon here; did you mean ';;'?");
-					++l->cur;
-				}
-			} break;
-			
-			case 'A': case 'B': case 'C': case 'D':
-			case 'E': case 'F': case 'G': case 'H':
-			case 'I': case 'J': case 'K': case 'L':
-			case 'M': case 'N': case 'O': case 'P':
-			case 'Q': case 'R': case 'S': case 'T':
-			case 'U': case 'V': case 'W': case 'X':
-			case 'Y': case 'Z': 
-			case 'a': case 'b': case 'c': case 'd':
-			case 'e': case 'f': case 'g': case 'h':
-			case 'i': case 'j': case 'k': case 'l':
-			case 'm': case 'n': case 'o': case 'p':
-			case 'q': case 'r': case 's': case 't':
-			case 'u': case 'v': case 'w': case 'x':
-			case 'y': case 'z':
-			case '_':
-				lex_identifier(l);
-				break;
-
-			case '0':
-			case '1':
-			case '2':
-			case '3':
-			case '4':
-			case '5':
-			case '6':
-			case '7':
-			case '8':
-			case '9':
-				lex_number(l);
-				break;
-				
-			default: {
-				error_at_current(l, "invalid char literal '%c' (dec: %d)", *l->cur, (int)(*l->cur));
-				++l->cur;
-			} break;
-		}
+	l->token_line = 0;
+	l->quiet = false;
+}
+
+TokenStore* lexer_run(Lexer* l, SourceFile* file, error_code* out_error_code) {
+	lexer_init(l, file);
+
+	while (l->cur < l->end) {
+		lex_once(l);
 
 		if (l->error_count > LEXER_ERROR_COUNT_MAX) {
 			/* TODO: refactor note in function */
-			printf("note: error count (%d) exceeded limit; aborting...\n",
-				   l->error_count);
+			diag_message("note: error count (%d) exceeded limit; aborting...",
+						 l->error_count);
 			if (out_error_code) *out_error_code = l->error_occured;
-			return l->tokens;
+			return &l->tokens;
 		}
 	}
 
 	if (out_error_code) *out_error_code = l->error_occured;
 	add_eof(l);
-	lexer_destroy(l);
-	return l->tokens;
+	return &l->tokens;
 }
 
-static void lexer_destroy(Lexer* l) {
-	buf_free(l->keywords);
+/* start of the first line at or after 'cur' that begins with '[' */
+char* lexer_find_split(char* cur, char* end) {
+	while (cur < end) {
+		cur = scan_line_end(cur, end);
+		if (cur >= end) break;
+		if (*cur == '\n' && cur[1] == '[') return cur + 1;
+		++cur;
+	}
+	return end;
 }
 
-static void lex_identifier(Lexer* l) {
-	++l->cur;
-	while (isalnum(*l->cur) || *l->cur == '_') {
-		++l->cur;
+void lexer_start(Lexer* l, SourceFile* file) {
+	lexer_init(l, file);
+}
+
+/* pull mode over [start, end) only, where 'start' is the start of line
+ * 'line' (e.g. a split from lexer_find_split); errors are not printed */
+void lexer_start_range(Lexer* l, SourceFile* file,
+					   char* start, char* end, u64 line) {
+	lexer_init(l, file);
+	l->quiet = true;
+	l->cur = start;
+	l->end = end;
+	if (start != file->contents) {
+		l->line = line;
+		l->last_newline = start - 1;
 	}
+}
 
-	u64 keywords_len = buf_len(l->keywords);
-	char* keyword = str_intern_range(l->start, l->cur);
-	bool is_keyword = false;
-	for (uint i = 0; i < keywords_len; ++i) {
-		if (keyword == str_intern(l->keywords[i])) {
-			is_keyword = true;
+/* whether a range lexer stopped right at the end of its range, on a
+ * newline it lexed itself; if not, the range ended inside a token
+ * (e.g. a multi-line string) and its tokens cannot be trusted */
+bool lexer_range_complete(Lexer* l) {
+	return l->cur == l->end && l->last_newline == l->end - 1;
+}
+
+/* pull mode: hands out the next token and keeps nothing else around;
+ * 'tokens' only ever holds the token being returned. once the input
+ * is exhausted (or the error limit is hit) every call returns EOF. */
+Token lexer_next(Lexer* l) {
+	l->tokens.len = 0;
+	while (l->tokens.len == 0 && l->cur < l->end &&
+		   l->error_count <= LEXER_ERROR_COUNT_MAX) {
+		lex_once(l);
+
+		if (l->error_count > LEXER_ERROR_COUNT_MAX && !l->quiet) {
+			diag_message("note: error count (%d) exceeded limit; aborting...",
+						 l->error_count);
 		}
 	}
 
-	Token* new = (Token*)malloc(sizeof(Token));
-	new->type = is_keyword ? TOKEN_KEYWORD : TOKEN_IDENTIFIER;
-	new->lexeme = keyword;
-	new->srcfile = l->srcfile;
-	new->line = l->line;
-	new->column = get_column(l);
-	buf_push(l->tokens, new);
+	if (l->tokens.len == 0) {
+		add_eof(l);
+	}
+	return token_store_get_from(&l->tokens, l->srcfile, 0, &l->token_line);
+}
+
+/* re-lexes 'file', which is the old file with 'edit' applied, reusing
+ * 'old_tokens' wherever the edit cannot have changed them. lexing
+ * restarts at the start of the line holding the last token before the
+ * edit, backing up further while a string from an earlier line ends
+ * on it. it stops as soon as a token past the edit lines up with an
+ * old token (same offset after the edit, type and lexeme): lexing
+ * from there on sees the same bytes as before, so the rest of the old
+ * tokens only need their offsets moved. */
+TokenStore* lexer_relex(Lexer* l, SourceFile* file, TokenStore* old_tokens,
+						SourceEdit* edit, TokenRange* out_changed,
+						error_code* out_error_code) {
+	assert(old_tokens->len > 0);
+	assert(old_tokens->types[old_tokens->len - 1] == TOKEN_EOF);
+	lexer_init(l, file);
+
+	const u64 edit_end = edit->offset + edit->inserted_len;
+	const u64 removed_end = edit->offset + edit->removed_len;
+
+	/* everything in front of the edit is the same in both files, so
+	 * the new file's line index works for the old offsets there */
+	u64 restart = last_token_before(old_tokens, edit->offset);
+	if (restart == old_tokens->len) {
+		restart = 0;
+	}
+	else {
+		u64 line_start = 0;
+		for (;;) {
+			u64 line;
+			u32 column;
+			get_position_at(file, old_tokens->offsets[restart], &line, &column);
+			line_start = old_tokens->offsets[restart] - (column - 1);
+			while (restart > 0 && old_tokens->offsets[restart - 1] >= line_start) {
+				--restart;
+			}
+			if (restart == 0 || !has_newline(old_tokens->lexemes[restart - 1])) break;
+			--restart;
+		}
+		restart_at_line_of(l, line_start);
+	}
+
+	for (u64 i = 0; i < restart; ++i) {
+		token_store_push(&l->tokens, old_tokens->types[i], old_tokens->keywords[i],
+						 old_tokens->lexemes[i], old_tokens->offsets[i]);
+	}
+
+	u64 resync = old_tokens->len;
+	while (l->cur < l->end && resync == old_tokens->len) {
+		u64 len_before = l->tokens.len;
+		lex_once(l);
+		if (l->tokens.len == len_before) continue;
+
+		u64 idx = l->tokens.len - 1;
+		u64 offset = l->tokens.offsets[idx];
+		if (offset >= edit_end) {
+			u64 old_idx;
+			if (find_token_at(old_tokens, offset - edit_end + removed_end, &old_idx) &&
+				old_tokens->types[old_idx] == l->tokens.types[idx] &&
+				old_tokens->lexemes[old_idx] == l->tokens.lexemes[idx]) {
+				resync = old_idx;
+			}
+		}
+
+		if (l->error_count > LEXER_ERROR_COUNT_MAX) {
+			diag_message("note: error count (%d) exceeded limit; aborting...",
+						 l->error_count);
+			break;
+		}
+	}
+
+	u64 new_count = 0;
+	if (resync != old_tokens->len) {
+		/* the resync token itself is taken from the old store */
+		--l->tokens.len;
+		new_count = l->tokens.len - restart;
+		for (u64 i = resync; i < old_tokens->len; ++i) {
+			token_store_push(&l->tokens, old_tokens->types[i], old_tokens->keywords[i],
+							 old_tokens->lexemes[i],
+							 old_tokens->offsets[i] - removed_end + edit_end);
+		}
+	}
+	else {
+		add_eof(l);
+		new_count = l->tokens.len - restart;
+	}
+
+	if (out_changed) {
+		out_changed->first = restart;
+		out_changed->old_count = resync - restart;
+		out_changed->new_count = new_count;
+	}
+	if (out_error_code) *out_error_code = l->error_occured;
+	return &l->tokens;
+}
+
+/* puts the lexer at 'line_start', in the same state the full lexer was
+ * in when it got there */
+static void restart_at_line_of(Lexer* l, u64 line_start) {
+	char* contents = l->srcfile->contents;
+	u32 column;
+	get_position_at(l->srcfile, line_start, &l->line, &column);
+	l->cur = contents + line_start;
+	l->last_newline = (line_start == 0 ? contents : contents + line_start - 1);
+}
+
+/* only string and char lexemes can hold a newline */
+static bool has_newline(char* lexeme) {
+	return strchr(lexeme, '\n') != null;
+}
+
+/* index of the last non-EOF token starting before 'offset', or
+ * 'tokens->len' if there is none */
+static u64 last_token_before(TokenStore* tokens, u64 offset) {
+	u64 lo = 0;
+	u64 hi = tokens->len - 1;
+	while (lo < hi) {
+		u64 mid = lo + (hi - lo) / 2;
+		if (tokens->offsets[mid] < offset) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo == 0 ? tokens->len : lo - 1;
+}
+
+static bool find_token_at(TokenStore* tokens, u64 offset, u64* out_idx) {
+	u64 lo = 0;
+	u64 hi = tokens->len - 1;
+	while (lo < hi) {
+		u64 mid = lo + (hi - lo) / 2;
+		if (tokens->offsets[mid] < offset) lo = mid + 1;
+		else hi = mid;
+	}
+	if (lo < tokens->len - 1 && tokens->offsets[lo] == offset) {
+		*out_idx = lo;
+		return true;
+	}
+	return false;
+}
+
+/* lexes whatever starts at the cursor: a token, a newline, a comment
+ * or a run of whitespace */
+static void lex_once(Lexer* l) {
+	l->start = l->cur;
+	switch (*l->cur) {
+		case ':': add_token(l, TOKEN_COLON); break;
+		case '+': add_token(l, TOKEN_PLUS);  break;
+		case '-': add_token(l, TOKEN_MINUS); break;
+		case '*': add_token(l, TOKEN_STAR);  break;
+		case '/': add_token(l, TOKEN_SLASH); break;
+		case '%': add_token(l, TOKEN_PERCENT); break;
+		case '[': add_token(l, TOKEN_LEFT_BRACKET); break;
+		case ']': add_token(l, TOKEN_RIGHT_BRACKET); break;
+		case '=': add_token(l, TOKEN_EQUAL); break;
+		case ',': add_token(l, TOKEN_COMMA); break;
+		case '.': add_token(l, TOKEN_DOT); break;
+		case '<': match_char(l, '=') ? add_token(l, TOKEN_LESS_EQUAL) : add_token(l, TOKEN_LESS); break;
+		case '>': match_char(l, '=') ? add_token(l, TOKEN_GREATER_EQUAL) : add_token(l, TOKEN_GREATER); break;
+			
+		case '"':  lex_string(l); break;
+		case '\'': lex_char(l); break;	
+		case '\n': lex_newline(l); break;
+
+		case '\t':
+		case '\r':
+		case ' ': l->cur = scan_whitespace(l->cur + 1, l->end); break;
+
+		case ';': {
+			if (match_char(l, ';')) {
+				lex_comment(l);
+			}
+			else {
+				error_at_current(l, "invalid semicolon here; did you mean ';;'?");
+				++l->cur;
+			}
+		} break;
+		
+		case 'A': case 'B': case 'C': case 'D':
+		case 'E': case 'F': case 'G': case 'H':
+		case 'I': case 'J': case 'K': case 'L':
+		case 'M': case 'N': case 'O': case 'P':
+		case 'Q': case 'R': case 'S': case 'T':
+		case 'U': case 'V': case 'W': case 'X':
+		case 'Y': case 'Z': 
+		case 'a': case 'b': case 'c': case 'd':
+		case 'e': case 'f': case 'g': case 'h':
+		case 'i': case 'j': case 'k': case 'l':
+		case 'm': case 'n': case 'o': case 'p':
+		case 'q': case 'r': case 's': case 't':
+		case 'u': case 'v': case 'w': case 'x':
+		case 'y': case 'z':
+		case '_':
+			lex_identifier(l);
+			break;
+
+		case '0':
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+		case '8':
+		case '9':
+			lex_number(l);
+			break;
+			
+		default: {
+			error_at_current(l, "invalid char literal '%c' (dec: %d)", *l->cur, (int)(*l->cur));
+			++l->cur;
+		} break;
+	}
+}
+
+static void lex_identifier(Lexer* l) {
+	l->cur = scan_identifier(l->cur + 1, l->end);
+
+	KeywordType keyword = lookup_keyword(l->start, l->cur - l->start);
+	token_store_push(&l->tokens,
+					 keyword != KEYWORD_NONE ? TOKEN_KEYWORD : TOKEN_IDENTIFIER,
+					 keyword, str_intern_range(l->start, l->cur),
+					 l->start - l->srcfile->contents);
 }
 
 static void lex_number(Lexer* l) {
@@ -169,22 +356,29 @@ static void lex_number(Lexer* l) {
 	add_token(l, TOKEN_NUMBER);
 }
 
+/* a string can span lines; its newlines are counted after the token
+ * is added, so that the token (or the error) is at its first line */
 static void lex_string(Lexer* l) {
 	++l->start;
-	++l->cur;
-	while ((*l->cur) != '"') {
-		if (*l->cur == '\0') {
-			error_at_current(l, "missing terminating '\"'");
-		}
-		++l->cur;
+	l->cur = scan_string_end(l->cur + 1, l->end);
+	if (l->cur >= l->end || *l->cur == '\0') {
+		error_at_current(l, "missing terminating '\"'");
+		count_newlines(l, l->start, l->cur);
+		return;
 	}
 	--l->cur;
 	add_token(l, TOKEN_STRING);
+	count_newlines(l, l->start, l->cur);
 	++l->cur;
 }
 
 static void lex_char(Lexer* l) {
 	++l->start;
+	if (l->cur + 2 > l->end) {
+		l->cur = l->end;
+		error_at_current(l, "missing terminating \"'\"");
+		return;
+	}
 	l->cur += 2;
 	/* TODO: escape sequences */
 	if ((*l->cur) != '\'') {
@@ -192,49 +386,39 @@ static void lex_char(Lexer* l) {
 	}
 	--l->cur;
 	add_token(l, TOKEN_CHAR);
+	count_newlines(l, l->start, l->cur);
 	++l->cur;
 }
 
 static void lex_comment(Lexer* l) {
-	while (*l->cur != '\n') {
-		if (*l->cur == '\0') return;
-		++l->cur;
-	}
+	l->cur = scan_line_end(l->cur, l->end);
 }
 
 static void lex_newline(Lexer* l) {
-	l->last_to_last_newline = l->last_newline;
 	l->last_newline = l->cur;
 	++l->line;
 	++l->cur;
 }
 
+/* lines are physical lines: a newline that is part of a token moves
+ * the lexer to the next line just like one between tokens */
+static void count_newlines(Lexer* l, char* start, char* end) {
+	for (char* c = start; c < end; ++c) {
+		if (*c != '\n') continue;
+		l->last_newline = c;
+		++l->line;
+	}
+}
+
 static void add_token(Lexer* l, TokenType type) {
-	Token* new = (Token*)malloc(sizeof(Token));
-	new->type = type;
-	new->lexeme = str_intern_range(l->start, ++l->cur);
-	new->srcfile = l->srcfile;
-	new->line = l->line;
-	new->column = get_column(l);
-	buf_push(l->tokens, new);
+	token_store_push(&l->tokens, type, KEYWORD_NONE,
+					 str_intern_range(l->start, ++l->cur),
+					 l->start - l->srcfile->contents);
 }
 
 static void add_eof(Lexer* l) {
-	bool newline = false;
-	u64 eof_line = l->line;
-	if (*(l->cur - 1) == '\n') {
-		newline = true;
-		--eof_line;
-	}
-
-	Token* t = (Token*)malloc(sizeof(Token));
-	t->type = TOKEN_EOF;
-	t->lexeme = "";
-	t->srcfile = l->srcfile;
-	t->line = eof_line;
-	if (newline) t->column = l->cur - l->last_to_last_newline - 1;
-	else t->column = l->cur - l->last_newline;
-	buf_push(l->tokens, t);
+	token_store_push(&l->tokens, TOKEN_EOF, KEYWORD_NONE, "",
+					 l->cur - l->srcfile->contents);
 }
 
 static bool match_char(Lexer* l, char c) {
@@ -248,7 +432,7 @@ static bool match_char(Lexer* l, char c) {
 }
 
 static bool is_at_end(Lexer* l) {
-	if (l->cur >= (l->srcfile->contents + l->srcfile->len)) {
+	if (l->cur >= l->end) {
 		return true;
 	}
 	return false;
@@ -261,58 +445,83 @@ static u32 get_column(Lexer* l) {
 }
 
 static void error_at_current(Lexer* l, const char* msg, ...) {
-	u32 column = get_column(l);
-	va_list ap;
-	va_start(ap, msg);
-	printf("%s:%ld:%d: error: ", l->srcfile->fpath, l->line, column);
-	vprintf(msg, ap);
-	printf("\n");
-	va_end(ap);
-
-	print_file_line_with_info(l->srcfile, l->line);
-	print_marker_arrow_with_info_ln(l->srcfile, l->line, column);
+	if (!l->quiet) {
+		va_list ap;
+		va_start(ap, msg);
+		diag_vreport(DIAG_ERROR, l->srcfile, l->line, get_column(l), msg, ap);
+		va_end(ap);
+	}
 
 	l->error_occured = ETHER_ERROR;
 	++l->error_count;
 }
 
-static void init_keywords(Lexer* l) {
-	buf_push(l->keywords, str_intern("struct"));
-	buf_push(l->keywords, str_intern("defn"));
-	buf_push(l->keywords, str_intern("decl"));
-	buf_push(l->keywords, str_intern("pub"));	
-	buf_push(l->keywords, str_intern("load"));
-	buf_push(l->keywords, str_intern("let"));
-	buf_push(l->keywords, str_intern("extern"));
-	buf_push(l->keywords, str_intern("if"));
-	buf_push(l->keywords, str_intern("elif"));
-	buf_push(l->keywords, str_intern("else"));
-	buf_push(l->keywords, str_intern("for"));
-	buf_push(l->keywords, str_intern("while"));
-	buf_push(l->keywords, str_intern("to"));
-	buf_push(l->keywords, str_intern("return"));	
-	buf_push(l->keywords, str_intern("set"));
-	buf_push(l->keywords, str_intern("deref"));
-	buf_push(l->keywords, str_intern("addr"));
-	buf_push(l->keywords, str_intern("at"));
-	
-	buf_push(l->keywords, str_intern("int"));
-
-	buf_push(l->keywords, str_intern("i8"));
-	buf_push(l->keywords, str_intern("i16"));
-	buf_push(l->keywords, str_intern("132"));
-	buf_push(l->keywords, str_intern("i64"));
-	
-	buf_push(l->keywords, str_intern("u8"));
-	buf_push(l->keywords, str_intern("u16"));
-	buf_push(l->keywords, str_intern("u32"));
-	buf_push(l->keywords, str_intern("u64"));
-
-	buf_push(l->keywords, str_intern("char"));
-	buf_push(l->keywords, str_intern("bool"));
-	buf_push(l->keywords, str_intern("void"));
-	
-	buf_push(l->keywords, str_intern("null"));
-	buf_push(l->keywords, str_intern("true"));
-	buf_push(l->keywords, str_intern("false"));
+#define KEYWORD(str, kw) \
+	if (memcmp(start, str, len) == 0) return kw
+
+/* classifies an identifier lexeme by its length and first character
+ * so that at most a couple of memcmp's are done per identifier */
+KeywordType lookup_keyword(char* start, u64 len) {
+	switch (len) {
+		case 2: {
+			switch (start[0]) {
+				case 'i': KEYWORD("if", KEYWORD_IF);
+						  KEYWORD("i8", KEYWORD_I8); break;
+				case 'u': KEYWORD("u8", KEYWORD_U8); break;
+				case 't': KEYWORD("to", KEYWORD_TO); break;
+				case 'a': KEYWORD("at", KEYWORD_AT); break;
+			}
+		} break;
+
+		case 3: {
+			switch (start[0]) {
+				case 'p': KEYWORD("pub", KEYWORD_PUB); break;
+				case 'l': KEYWORD("let", KEYWORD_LET); break;
+				case 'f': KEYWORD("for", KEYWORD_FOR); break;
+				case 's': KEYWORD("set", KEYWORD_SET); break;
+				case 'i': KEYWORD("int", KEYWORD_INT);
+						  KEYWORD("i16", KEYWORD_I16);
+						  KEYWORD("i32", KEYWORD_I32);
+						  KEYWORD("i64", KEYWORD_I64); break;
+				case 'u': KEYWORD("u16", KEYWORD_U16);
+						  KEYWORD("u32", KEYWORD_U32);
+						  KEYWORD("u64", KEYWORD_U64); break;
+			}
+		} break;
+
+		case 4: {
+			switch (start[0]) {
+				case 'd': KEYWORD("defn", KEYWORD_DEFN);
+						  KEYWORD("decl", KEYWORD_DECL); break;
+				case 'l': KEYWORD("load", KEYWORD_LOAD); break;
+				case 'e': KEYWORD("elif", KEYWORD_ELIF);
+						  KEYWORD("else", KEYWORD_ELSE); break;
+				case 'a': KEYWORD("addr", KEYWORD_ADDR); break;
+				case 'c': KEYWORD("char", KEYWORD_CHAR); break;
+				case 'b': KEYWORD("bool", KEYWORD_BOOL); break;
+				case 'v': KEYWORD("void", KEYWORD_VOID); break;
+				case 'n': KEYWORD("null", KEYWORD_NULL); break;
+				case 't': KEYWORD("true", KEYWORD_TRUE); break;
+			}
+		} break;
+
+		case 5: {
+			switch (start[0]) {
+				case 'w': KEYWORD("while", KEYWORD_WHILE); break;
+				case 'd': KEYWORD("deref", KEYWORD_DEREF); break;
+				case 'f': KEYWORD("false", KEYWORD_FALSE); break;
+			}
+		} break;
+
+		case 6: {
+			switch (start[0]) {
+				case 's': KEYWORD("struct", KEYWORD_STRUCT); break;
+				case 'e': KEYWORD("extern", KEYWORD_EXTERN); break;
+				case 'r': KEYWORD("return", KEYWORD_RETURN); break;
+			}
+		} break;
+	}
+	return KEYWORD_NONE;
 }
+
+#undef KEYWORD
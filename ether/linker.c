@@ -1,90 +1,101 @@
 #include <ether/ether.h>
 #include <ether/linker_resolve_code_gen_common.h>
 
+/* the linker binds every name in the tree to its declaration. the
+ * top-level names are declared up front by linker_init, so that they
+ * can be used before they are defined; the rest of the tree is linked
+ * node by node, by the link_* hooks resolve calls as it walks it (see
+ * resolve_run). */
+
 static Stmt** stmts;
-static Stmt** defined_structs;
-static Stmt** defined_functions;
-static Scope* global_scope;
-static Scope* current_scope;
-static Scope** all_scopes;
+static Stmt** defined_structs; /* in order of definition */
+/* names are looked up in arrays indexed by symbol. every name in the
+ * tree is interned by the time the linker runs, so the arrays are
+ * sized once in linker_init */
+static u32 symbol_count;
+static Stmt** struct_names;
+static Stmt** function_names; /* the first decl or definition */
+/* every variable in scope, innermost last. a scope owns the variables
+ * from its start to the next scope's start, so leaving it only pops
+ * them; 'innermost_variables' holds the index + 1 of the innermost
+ * declaration of each name */
+static ScopeVariable* scope_variables;
+static u64* scope_starts;
+static u64* innermost_variables;
 
 static bool error_occured;
 static uint error_count;
-
-static void linker_destroy(void);
+static Expr** pending_exprs;
 
 static void link_file(Stmt**);
 static void add_decl_stmt(Stmt*);
 
-static void check_file(Stmt**);
-static void check_stmt(Stmt*);
 static void check_struct(Stmt*);
 static void check_func(Stmt*);
-static void check_func_decl(Stmt*);
-static void check_global_var_decl(Stmt*);
-static void check_var_decl(Stmt*);
-static void check_extern_stmt(Stmt*);
-static void check_if_stmt(Stmt*);
-static void check_if_branch(IfBranch*, IfBranchType);
 static void check_for_stmt(Stmt*);
-static void check_while_stmt(Stmt*);
-static void check_return_stmt(Stmt*);
-static void check_expr_stmt(Stmt*);
-
-static void check_expr(Expr*);
-static void check_dot_access_expr(Expr*);
-static void check_func_call(Expr*);
-static void check_set_expr(Expr*);
-static void check_deref_expr(Expr*);
-static void check_addr_expr(Expr*);
-static void check_at_expr(Expr*);
-static void check_arithmetic_expr(Expr*);
-static void check_comparision_expr(Expr*);
+static void check_var_decl(Stmt*);
+
+static bool check_func_call(Expr*);
+static bool check_set_expr(Expr*);
+static bool check_deref_expr(Expr*);
+static bool check_addr_expr(Expr*);
+static bool check_at_expr(Expr*);
+static bool check_arithmetic_expr(Expr*);
+static bool check_comparision_expr(Expr*);
 static void check_variable_expr(Expr*);
 
 static void check_data_type(DataType*);
 static Stmt* check_data_type_return_struct_if_identifier(DataType*_type);
 static void check_if_variable_is_in_scope(Expr*);
-static bool is_variable_declared(Stmt*, Scope*);
+static bool is_variable_declared(Stmt*, u64);
 static bool func_decls_match(Stmt*, Stmt*);
+static Stmt* lookup_name(Stmt**, Token*);
 
-static Scope* make_scope(Scope*);
+static void push_scope(void);
+static void pop_scope(void);
 static void add_variable_to_scope(Stmt*);
+static ScopeVariable* find_variable(Token*);
 
-#define CHANGE_SCOPE(x) \
-	Scope* x = make_scope(current_scope); \
-	current_scope = x;
-
-#define REVERT_SCOPE(x) \
-	current_scope = x->parent_scope;
+/* the outermost scope is_variable_declared() looks in */
+#define GLOBAL_SCOPE 0
+#define FUNCTION_SCOPE 1
 
-void linker_init(Stmt** p_stmts) {
+Stmt** linker_init(Stmt** p_stmts) {
 	stmts = p_stmts;
-	all_scopes = null;
-	global_scope = make_scope(null);
-	current_scope = global_scope;
+	symbol_count = str_symbol_count();
+	struct_names = (Stmt**)calloc(symbol_count, sizeof(Stmt*));
+	function_names = (Stmt**)calloc(symbol_count, sizeof(Stmt*));
+	innermost_variables = (u64*)calloc(symbol_count, sizeof(u64));
+	assert(struct_names && function_names && innermost_variables);
+	scope_variables = null;
+	scope_starts = null;
+	push_scope();
+
+	link_file(stmts);
+	return defined_structs;
 }
 
-Stmt** linker_run(error_code* err_code) {
-	link_file(stmts);		
-	check_file(stmts);
-	
-	linker_destroy();
-	if (err_code) *err_code = error_occured;
-	return defined_structs;
+bool linker_error_occured(void) {
+	return error_occured;
 }
 
-static void linker_destroy(void) {
-	buf_free(defined_functions);
-	
-	for (u64 i = 0; i < buf_len(all_scopes); ++i) {
-		buf_free(all_scopes[i]->variables);
-		free(all_scopes[i]);
-	}
-	buf_free(all_scopes);
-	
-	global_scope = null;
-	current_scope = null;
+/* leaves the linker as it was before linker_init, so that it can link
+ * another tree; the structs linker_init returned are freed as well */
+void linker_destroy(void) {
+	free(struct_names);
+	free(function_names);
+	free(innermost_variables);
+	struct_names = null;
+	function_names = null;
+	innermost_variables = null;
+	symbol_count = 0;
+	stmts = null;
+	buf_free(defined_structs);
+	buf_free(pending_exprs);
+	buf_free(scope_variables);
+	buf_free(scope_starts);
+	error_occured = false;
+	error_count = 0;
 }
 
 static void link_file(Stmt** p_stmts) {
@@ -95,85 +106,97 @@ static void link_file(Stmt** p_stmts) {
 
 static void add_decl_stmt(Stmt* stmt) {
 	if (stmt->type == STMT_STRUCT) {
-		for (u64 i = 0; i < buf_len(defined_structs); ++i) {
-			if (is_token_identical(stmt->struct_stmt.identifier,
-								   defined_structs[i]->struct_stmt.identifier)) {
-				error(stmt->struct_stmt.identifier,
-					  "redefinition of struct '%s':",
-					  stmt->struct_stmt.identifier->lexeme);
-				note(defined_structs[i]->struct_stmt.identifier,
-					 "struct '%s' previously defined here: ",
-					 defined_structs[i]->struct_stmt.identifier->lexeme);
-				return;
-			}
+		Stmt* previous = lookup_name(struct_names, stmt->struct_stmt.identifier);
+		if (previous) {
+			error(stmt->struct_stmt.identifier,
+				  "redefinition of struct '%s':",
+				  stmt->struct_stmt.identifier->lexeme);
+			note(previous->struct_stmt.identifier,
+				 "struct '%s' previously defined here: ",
+				 previous->struct_stmt.identifier->lexeme);
+			return;
 		}
+		struct_names[stmt->struct_stmt.identifier->symbol] = stmt;
 		buf_push(defined_structs, stmt);
 	}
 
+	/* only the first declaration of a name is kept: a definition after
+	 * it is an error, and a later decl that matches it matches every
+	 * other decl of the name as well */
 	else if (stmt->type == STMT_FUNC) {
-		for (u64 i = 0; i < buf_len(defined_functions); ++i) {
-			if (is_token_identical(stmt->func.identifier,
-								   defined_functions[i]->func.identifier)) {
-				if (stmt->func.is_function) {
-					error(stmt->func.identifier,
-						  "redefinition of function '%s':",
-						  stmt->func.identifier->lexeme);
-					note(defined_functions[i]->func.identifier,
-						 "function '%s' previously defined here: ",
-						 defined_functions[i]->func.identifier->lexeme);
-					return;
-				}
-				else {
-					if (!func_decls_match(defined_functions[i], stmt)) {
-						return;
-					}
-				}
+		Stmt* previous = lookup_name(function_names, stmt->func.identifier);
+		if (previous) {
+			if (stmt->func.is_function) {
+				error(stmt->func.identifier,
+					  "redefinition of function '%s':",
+					  stmt->func.identifier->lexeme);
+				note(previous->func.identifier,
+					 "function '%s' previously defined here: ",
+					 previous->func.identifier->lexeme);
 			}
+			else {
+				func_decls_match(previous, stmt);
+			}
+			return;
 		}
-		buf_push(defined_functions, stmt);
+		function_names[stmt->func.identifier->symbol] = stmt;
 	}
 
 	else if (stmt->type == STMT_VAR_DECL) {
-		if (!is_variable_declared(stmt, null)) {
+		if (!is_variable_declared(stmt, GLOBAL_SCOPE)) {
 			add_variable_to_scope(stmt);
 		}
 	}
 }
 
-static void check_file(Stmt** p_stmts) {
-	for (u64 i = 0; i < buf_len(p_stmts); ++i) {
-		check_stmt(p_stmts[i]);
+/* what a statement links before its children: a function body, a
+ * 'for' or a 'while' is a scope that stays open until link_stmt_end */
+void link_stmt(Stmt* stmt) {
+	switch (stmt->type) {
+		case STMT_STRUCT: check_struct(stmt); break;
+		case STMT_FUNC: check_func(stmt); break;
+		case STMT_VAR_DECL: check_data_type(stmt->var_decl.type); break;
+		case STMT_FOR: check_for_stmt(stmt); break;
+		case STMT_WHILE: push_scope(); break;
+		case STMT_IF:
+		case STMT_RETURN:
+		case STMT_EXPR: break;
 	}
 }
 
-static void check_stmt(Stmt* stmt) {
+/* and what it links after them */
+void link_stmt_end(Stmt* stmt) {
 	switch (stmt->type) {
-		case STMT_STRUCT: check_struct(stmt); break;
 		case STMT_FUNC: {
 			if (stmt->func.is_function) {
-				check_func(stmt);
-			}
-			else {
-				check_func_decl(stmt);
+				pop_scope();
 			}
 		} break;
-			
+
 		case STMT_VAR_DECL: {
-			if (stmt->var_decl.is_global_var) {
-				check_global_var_decl(stmt);
-			}
-			else {
+			if (!stmt->var_decl.is_global_var) {
 				check_var_decl(stmt);
 			}
 		} break;
-		case STMT_IF: check_if_stmt(stmt); break;
-		case STMT_FOR: check_for_stmt(stmt); break;
-		case STMT_WHILE: check_while_stmt(stmt); break;	
-		case STMT_RETURN: check_return_stmt(stmt); break;	
-		case STMT_EXPR: check_expr_stmt(stmt); break;
+
+		case STMT_FOR:
+		case STMT_WHILE: pop_scope(); break;
+		case STMT_STRUCT:
+		case STMT_IF:
+		case STMT_RETURN:
+		case STMT_EXPR: break;
 	}
 }
 
+/* every if branch is a scope of its own, opened after its condition */
+void link_if_branch(void) {
+	push_scope();
+}
+
+void link_if_branch_end(void) {
+	pop_scope();
+}
+
 static void check_struct(Stmt* stmt) {
 	Field** fields = stmt->struct_stmt.fields;
 	for (u64 i = 0; i < buf_len(fields); ++i) {
@@ -187,232 +210,131 @@ static void check_struct(Stmt* stmt) {
 	}
 }
 
+/* the parameters of a decl are only checked against each other */
 static void check_func(Stmt* stmt) {
 	if (stmt->func.type->type->type == TOKEN_KEYWORD) {
-		if (str_intern(stmt->func.type->type->lexeme) ==
-			str_intern("void") &&
+		if (stmt->func.type->type->keyword == KEYWORD_VOID &&
 			stmt->func.type->pointer_count == 0) {
 		}
 	}
 	else {
 		check_data_type(stmt->func.type);
 	}
-	CHANGE_SCOPE(scope);
+	push_scope();
 
 	for (u64 param = 0; param < buf_len(stmt->func.params); ++param) {
-		if (!is_variable_declared(stmt->func.params[param], global_scope)) {
+		if (!is_variable_declared(stmt->func.params[param], FUNCTION_SCOPE)) {
 			add_variable_to_scope(stmt->func.params[param]);
 		}
 	}
-	
-	for (u64 i = 0; i < buf_len(stmt->func.body); ++i) {
-		check_stmt(stmt->func.body[i]);
-	}
-	REVERT_SCOPE(scope);
-}
-
-static void check_func_decl(Stmt* stmt) {
-	if (stmt->func.type->type->type == TOKEN_KEYWORD) {
-		if (str_intern(stmt->func.type->type->lexeme) ==
-			str_intern("void") &&
-			stmt->func.type->pointer_count == 0) {
-		}
-	}
-	else {
-		check_data_type(stmt->func.type);
-	}
-	CHANGE_SCOPE(scope);
 
-	for (u64 param = 0; param < buf_len(stmt->func.params); ++param) {
-		if (!is_variable_declared(stmt->func.params[param], global_scope)) {
-			add_variable_to_scope(stmt->func.params[param]);
-		}
+	if (!stmt->func.is_function) {
+		pop_scope();
 	}
-	REVERT_SCOPE(scope);
 }
 
-static void check_global_var_decl(Stmt* stmt) {
-	check_data_type(stmt->var_decl.type);
-	if (stmt->var_decl.initializer) {
-		/* TODO: add current variable to scope to reference it like this:
-		 * [let int:var [+ var 1]] */
-		check_expr(stmt->var_decl.initializer);
+static void check_for_stmt(Stmt* stmt) {
+	push_scope();
+	if (!is_variable_declared(stmt->for_stmt.counter, GLOBAL_SCOPE)) {
+		add_variable_to_scope(stmt->for_stmt.counter);
 	}
 }
 
+/* a local variable is in scope after its initializer
+ * TODO: add current variable to scope to reference it like this:
+ * [let int:var [+ var 1]] */
 static void check_var_decl(Stmt* stmt) {
-	check_data_type(stmt->var_decl.type);
-	if (stmt->var_decl.initializer) {
-		/* TODO: add current variable to scope to reference it like this:
-		 * [let int:var [+ var 1]] */
-		check_expr(stmt->var_decl.initializer);
-	}
-
-	/* always remember to add this at the end of check_var_decl,
-	 * not in the middle */
-	if (!is_variable_declared(stmt, null)) {
+	if (!is_variable_declared(stmt, GLOBAL_SCOPE)) {
 		add_variable_to_scope(stmt);
 	}
 }
 
-static void check_if_stmt(Stmt* stmt) {
-	check_if_branch(stmt->if_stmt.if_branch, IF_IF_BRANCH);
-
-	for (u64 i = 0; i < buf_len(stmt->if_stmt.elif_branch); ++i) {
-		check_if_branch(stmt->if_stmt.elif_branch[i], IF_ELIF_BRANCH);
-	}
-
-	if (stmt->if_stmt.else_branch) {
-		check_if_branch(stmt->if_stmt.else_branch, IF_ELSE_BRANCH);
-	}
-}
-
-static void check_if_branch(IfBranch* branch, IfBranchType type) {
-	if (type != IF_ELSE_BRANCH) {
-		check_expr(branch->cond);
-	}
-
-	CHANGE_SCOPE(scope);
-	for (u64 i = 0; i < buf_len(branch->body); ++i) {
-		check_stmt(branch->body[i]);
-	}
-	REVERT_SCOPE(scope);		
-}
-
-static void check_for_stmt(Stmt* stmt) {
-	CHANGE_SCOPE(scope);
-	if (!is_variable_declared(stmt->for_stmt.counter, null)) {
-		add_variable_to_scope(stmt->for_stmt.counter);
-	}
-	check_expr(stmt->for_stmt.to);
+/* links a single expression; false if its operands are not to be
+ * linked, because it is wrong in a way that makes them meaningless */
+bool link_expr(Expr* expr) {
+	switch (expr->type) {
+		case EXPR_DOT_ACCESS: return true;
+		case EXPR_FUNC_CALL: return check_func_call(expr);
+		case EXPR_SET: return check_set_expr(expr);
+		case EXPR_DEREF: return check_deref_expr(expr);
+		case EXPR_ADDR: return check_addr_expr(expr);
+		case EXPR_AT: return check_at_expr(expr);
+		case EXPR_ARITHMETIC: return check_arithmetic_expr(expr);
+		case EXPR_COMPARISON: return check_comparision_expr(expr);
 
-	for (u64 i = 0; i < buf_len(stmt->for_stmt.body); ++i) {
-		check_stmt(stmt->for_stmt.body[i]);
+		case EXPR_VARIABLE: check_variable_expr(expr); break;
+		case EXPR_NUMBER:
+		case EXPR_CHAR:	
+		case EXPR_STRING:
+		case EXPR_NULL:
+		case EXPR_BOOL: break;
 	}
-	REVERT_SCOPE(scope);
+	return false;
 }
 
-static void check_while_stmt(Stmt* stmt) {
-	CHANGE_SCOPE(scope);
-	check_expr(stmt->while_stmt.cond);
-
-	for (u64 i = 0; i < buf_len(stmt->while_stmt.body); ++i) {
-		check_stmt(stmt->while_stmt.body[i]);
-	}	
-	REVERT_SCOPE(scope);
-}
+/* links 'root' and everything below it, for the parts of the tree
+ * resolve does not walk itself. depth-first with an explicit stack,
+ * since expressions can nest far deeper than the C stack allows. an
+ * expression is linked before its operands, and the operands are
+ * pushed in reverse so that they are linked left to right. */
+void link_expr_tree(Expr* root) {
+	u64 base = buf_len(pending_exprs);
+	buf_push(pending_exprs, root);
+	while (buf_len(pending_exprs) > base) {
+		Expr* expr = pending_exprs[buf_len(pending_exprs) - 1];
+		buf_pop(pending_exprs);
+
+		if (!link_expr(expr)) continue;
+		if (expr->type == EXPR_DOT_ACCESS) {
+			buf_push(pending_exprs, expr->dot.left);
+			continue;
+		}
 
-static void check_return_stmt(Stmt* stmt) {
-	if (stmt->return_stmt.expr) {
-		check_expr(stmt->return_stmt.expr);
+		Expr** args = expr->func_call.args;
+		for (u64 i = buf_len(args); i > 0; --i) {
+			buf_push(pending_exprs, args[i - 1]);
+		}
 	}
 }
 
-static void check_expr_stmt(Stmt* stmt) {
-	check_expr(stmt->expr);
-}
+static bool check_func_call(Expr* expr) {
+	Stmt* callee = lookup_name(function_names, expr->func_call.callee);
+	if (callee) {
+		const u64 caller_args_len = buf_len(expr->func_call.args);
+		const u64 callee_params_len = buf_len(callee->func.params);
+		Token* error_token = null;
 
-static void check_expr(Expr* expr) {
-	switch (expr->type) {
-		case EXPR_DOT_ACCESS: check_dot_access_expr(expr); break;
-		case EXPR_FUNC_CALL: check_func_call(expr); break;
-		case EXPR_VARIABLE: check_variable_expr(expr); break;
-		case EXPR_NUMBER:
-		case EXPR_CHAR:	
-		case EXPR_STRING: break;
-	}
-}
-
-static void check_dot_access_expr(Expr* expr) {
-	check_expr(expr->dot.left);	
-}
-
-static void check_func_call(Expr* expr) {
-	if (expr->func_call.callee->type == TOKEN_IDENTIFIER) {
-		for (u64 i = 0; i < buf_len(defined_functions); ++i) {
-			if (is_token_identical(expr->func_call.callee,
-								   defined_functions[i]->func.identifier)) {
-				const u64 caller_args_len = buf_len(expr->func_call.args);
-				const u64 callee_params_len = buf_len(defined_functions[i]->func.params);
-				Token* error_token = null;
-
-				if (caller_args_len > callee_params_len) {
-					error_token = expr->func_call.args[callee_params_len]->head;
-				}
-				else if (caller_args_len < callee_params_len) {
-					error_token = expr->head;
-				}
-				
-				if (error_token != null) {
-					error(error_token,
-						  "conflicting argument-length in function call; "
-						  "expected %ld argument(s), but got %ld argument(s);",
-						  callee_params_len, caller_args_len);
-					note(defined_functions[i]->func.identifier,
-						 "callee '%s' defined here:",
-						 defined_functions[i]->func.identifier->lexeme);
-					return;
-				}
-				
-				for (u64 arg = 0; arg < caller_args_len; ++arg) {
-					check_expr(expr->func_call.args[arg]);
-				}
-				expr->func_call.function_called = defined_functions[i];
-				return;
-			}
+		if (caller_args_len > callee_params_len) {
+			error_token = expr->func_call.args[callee_params_len]->head;
 		}
-
-		error(expr->func_call.callee,
-			  "implicit declaration of function '%s'; did you forget to define '%s'?"
-			  " (use a 'decl' statement to suppress this error);",
-			  expr->func_call.callee->lexeme,
-			  expr->func_call.callee->lexeme);
-		return;
-	} 
-	
-	else if (expr->func_call.callee->type == TOKEN_KEYWORD) {
-		if (str_intern(expr->func_call.callee->lexeme) ==
-			str_intern("set")) {
-			check_set_expr(expr);
+		else if (caller_args_len < callee_params_len) {
+			error_token = expr->head;
 		}
-		else if (str_intern(expr->func_call.callee->lexeme) ==
-				 str_intern("deref")) {
-			check_deref_expr(expr);
-		}
-		else if (str_intern(expr->func_call.callee->lexeme) ==
-				 str_intern("addr")) {
-			check_addr_expr(expr);
-		}
-		else if (str_intern(expr->func_call.callee->lexeme) ==
-				 str_intern("at")) {
-			check_at_expr(expr);
+		
+		if (error_token != null) {
+			error(error_token,
+				  "conflicting argument-length in function call; "
+				  "expected %ld argument(s), but got %ld argument(s);",
+				  callee_params_len, caller_args_len);
+			note(callee->func.identifier,
+				 "callee '%s' defined here:",
+				 callee->func.identifier->lexeme);
+			return false;
 		}
+		
+		expr->func_call.function_called = callee;
+		return true;
 	}
 
-	else {
-		switch (expr->func_call.callee->type) {
-			case TOKEN_PLUS:
-			case TOKEN_MINUS:
-			case TOKEN_STAR:
-			case TOKEN_SLASH: 
-			case TOKEN_PERCENT:
-				check_arithmetic_expr(expr); 
-				return;
-
-			case TOKEN_EQUAL: 
-			case TOKEN_LESS:
-			case TOKEN_LESS_EQUAL:
-			case TOKEN_GREATER:
-			case TOKEN_GREATER_EQUAL: 
-				check_comparision_expr(expr); 
-				return;
-
-			default: return;	
-		}
-	}
+	error(expr->func_call.callee,
+		  "implicit declaration of function '%s'; did you forget to define '%s'?"
+		  " (use a 'decl' statement to suppress this error);",
+		  expr->func_call.callee->lexeme,
+		  expr->func_call.callee->lexeme);
+	return false;
 }
 
-static void check_set_expr(Expr* expr) {
+static bool check_set_expr(Expr* expr) {
 	u64 args_len = buf_len(expr->func_call.args);
 	Token* error_token = null;
 								  
@@ -428,14 +350,13 @@ static void check_set_expr(Expr* expr) {
 		error(error_token,
 			  "built-in operator 'set' needs 2 arguments to operate, "
 			  "but got %ld argument(s);", args_len);
-		return;
+		return false;
 	}
 
-	check_expr(expr->func_call.args[0]);
-	check_expr(expr->func_call.args[1]);
+	return true;
 }
 
-static void check_deref_expr(Expr* expr) {
+static bool check_deref_expr(Expr* expr) {
 	u64 args_len = buf_len(expr->func_call.args);
 
 	if (args_len > 1) {
@@ -443,13 +364,13 @@ static void check_deref_expr(Expr* expr) {
 		error(expr->func_call.args[1]->head,
 			  "built-in operator 'deref' needs 1 argument to operate, "
 			  "but got %ld argument(s);", args_len);
-		return;
+		return false;
 	}
 
-	check_expr(expr->func_call.args[0]);
+	return true;
 }
 
-static void check_addr_expr(Expr* expr) {
+static bool check_addr_expr(Expr* expr) {
 	u64 args_len = buf_len(expr->func_call.args);
 
 	if (args_len > 1) {
@@ -457,13 +378,13 @@ static void check_addr_expr(Expr* expr) {
 		error(expr->func_call.args[1]->head,
 			  "built-in operator 'addr' needs 1 argument to operate, "
 			  "but got %ld argument(s);", args_len);
-		return;
+		return false;
 	}
 
-	check_expr(expr->func_call.args[0]);
+	return true;
 }
 
-static void check_at_expr(Expr* expr) {
+static bool check_at_expr(Expr* expr) {
 	u64 args_len = buf_len(expr->func_call.args);
 	Token* error_token = null;
 								  
@@ -479,14 +400,13 @@ static void check_at_expr(Expr* expr) {
 		error(error_token,
 			  "built-in operator 'at' needs 2 arguments to operate, "
 			  "but got %ld argument(s);", args_len);
-		return;
+		return false;
 	}
 
-	check_expr(expr->func_call.args[0]);
-	check_expr(expr->func_call.args[1]);
+	return true;
 }
 
-static void check_arithmetic_expr(Expr* expr) {
+static bool check_arithmetic_expr(Expr* expr) {
 	const u64 args_len = buf_len(expr->func_call.args);
 	Token* error_token = null;
 
@@ -500,15 +420,13 @@ static void check_arithmetic_expr(Expr* expr) {
 			  "but got %ld argument(s);",
 			  expr->func_call.callee->lexeme,
 			  args_len);
-		return;
+		return false;
 	}
 
-	for (u64 i = 0; i < args_len; ++i) {
-		check_expr(expr->func_call.args[i]);		
-	}
+	return true;
 }
 
-static void check_comparision_expr(Expr* expr) {
+static bool check_comparision_expr(Expr* expr) {
 	u64 args_len = buf_len(expr->func_call.args);
 	Token* error_token = null;
 								  
@@ -524,11 +442,10 @@ static void check_comparision_expr(Expr* expr) {
 			  "'%s' operator need 2 arguments to operate, "
 			  "but got %ld argument(s);", 
 			  expr->func_call.callee->lexeme, args_len);
-		return;
+		return false;
 	}
 
-	check_expr(expr->func_call.args[0]);	
-	check_expr(expr->func_call.args[1]);	
+	return true;
 }
 
 static void check_variable_expr(Expr* expr) {
@@ -542,13 +459,7 @@ static void check_data_type(DataType* data_type) {
 static Stmt* check_data_type_return_struct_if_identifier(DataType* data_type) {
 	assert(data_type);
 	if (data_type->type->type == TOKEN_IDENTIFIER) {
-		Stmt* struct_stmt = null;
-		for (u64 i = 0; i < buf_len(defined_structs); ++i) {
-			if (is_token_identical(data_type->type,
-								   defined_structs[i]->struct_stmt.identifier)) {
-				struct_stmt = defined_structs[i];
-			}
-		}
+		Stmt* struct_stmt = lookup_name(struct_names, data_type->type);
 	
 		if (!struct_stmt) {
 			error(data_type->type,
@@ -560,8 +471,7 @@ static Stmt* check_data_type_return_struct_if_identifier(DataType* data_type) {
 		return struct_stmt;
 	}
 	else if (data_type->type->type == TOKEN_KEYWORD) {
-		if (str_intern(data_type->type->lexeme) ==
-			str_intern("void") &&
+		if (data_type->type->keyword == KEYWORD_VOID &&
 			data_type->pointer_count == 0) {
 			error(data_type->type,
 				  "data type declared 'void' here: ");
@@ -571,30 +481,26 @@ static Stmt* check_data_type_return_struct_if_identifier(DataType* data_type) {
 	return null;
 }
 
-static bool is_variable_declared(Stmt* var, Scope* scope_to_check) {
-	Scope* scope = current_scope;
-	while (scope != scope_to_check) {
-		for (u64 i = 0; i < buf_len(scope->variables); ++i) {
-			if (is_token_identical(var->var_decl.identifier,
-								   scope->variables[i]->var_decl.identifier)) {
-				error(var->var_decl.identifier,
-					  "redeclaration of variable '%s':",
-					  var->var_decl.identifier->lexeme);
-				note(scope->variables[i]->var_decl.identifier,
-					 "variable '%s' previously declared here: ",
-					 scope->variables[i]->var_decl.identifier->lexeme);
-				return true;
-			}
-		}
-		scope = scope->parent_scope;
+/* declarations of a name only get older further out, so only the
+ * innermost one has to be checked against 'outermost_scope' */
+static bool is_variable_declared(Stmt* var, u64 outermost_scope) {
+	ScopeVariable* previous = find_variable(var->var_decl.identifier);
+	if (previous &&
+		(u64)(previous - scope_variables) >= scope_starts[outermost_scope]) {
+		error(var->var_decl.identifier,
+			  "redeclaration of variable '%s':",
+			  var->var_decl.identifier->lexeme);
+		note(previous->var->var_decl.identifier,
+			 "variable '%s' previously declared here: ",
+			 previous->var->var_decl.identifier->lexeme);
+		return true;
 	}
 	return false;
 }
 
 static bool func_decls_match(Stmt* a, Stmt* b) {
 	bool do_match = true;
-	if (str_intern(a->func.type->type->lexeme) !=
-		str_intern(b->func.type->type->lexeme)) {
+	if (!is_token_identical(a->func.type->type, b->func.type->type)) {
 		error(b->func.type->type,
 			  "conflicting return types for function '%s';",
 			  a->func.identifier->lexeme);
@@ -616,8 +522,8 @@ static bool func_decls_match(Stmt* a, Stmt* b) {
 
 	if (do_params_count_match) {
 		for (u64 i = 0; i < buf_len(a->func.params); ++i) {
-			if ((str_intern(a->func.params[i]->var_decl.type->type->lexeme) !=
-				 str_intern(b->func.params[i]->var_decl.type->type->lexeme)) ||
+			if (!is_token_identical(a->func.params[i]->var_decl.type->type,
+									b->func.params[i]->var_decl.type->type) ||
 				a->func.params[i]->var_decl.type->pointer_count !=
 				b->func.params[i]->var_decl.type->pointer_count) {
 				error(b->func.params[i]->var_decl.type->type,
@@ -628,8 +534,8 @@ static bool func_decls_match(Stmt* a, Stmt* b) {
 				do_match = false;
 			}
 
-			if (str_intern(a->func.params[i]->var_decl.identifier->lexeme) !=
-				str_intern(a->func.params[i]->var_decl.identifier->lexeme)) {
+			if (!is_token_identical(a->func.params[i]->var_decl.identifier,
+									a->func.params[i]->var_decl.identifier)) {
 				error(b->func.params[i]->var_decl.identifier,
 					  "conflicting parameter names for function '%s'",
 					  a->func.identifier->lexeme);
@@ -644,16 +550,10 @@ static bool func_decls_match(Stmt* a, Stmt* b) {
 }
 
 static void check_if_variable_is_in_scope(Expr* expr) {
-	Scope* scope = current_scope;
-	while (scope != null) {
-		for (u64 i = 0; i < buf_len(scope->variables); ++i) {
-			if (is_token_identical(expr->variable.identifier,
-								   scope->variables[i]->var_decl.identifier)) {
-				expr->variable.variable_decl_referenced = scope->variables[i];
-				return;
-			}
-		}
-		scope = scope->parent_scope;
+	ScopeVariable* variable = find_variable(expr->variable.identifier);
+	if (variable) {
+		expr->variable.variable_decl_referenced = variable->var;
+		return;
 	}
 
 	error(expr->variable.identifier,
@@ -661,14 +561,39 @@ static void check_if_variable_is_in_scope(Expr* expr) {
 		  expr->variable.identifier->lexeme, expr->variable.identifier->lexeme);
 }
 
-static Scope* make_scope(Scope* parent_scope) {
-	Scope* scope = (Scope*)malloc(sizeof(Scope));
-	scope->variables = null;
-	scope->parent_scope = parent_scope;
-	buf_push(all_scopes, scope);
-	return scope;
+static void push_scope(void) {
+	buf_push(scope_starts, buf_len(scope_variables));
+}
+
+/* every variable of the scope un-shadows the one it was hiding */
+static void pop_scope(void) {
+	u64 start = scope_starts[buf_len(scope_starts) - 1];
+	while (buf_len(scope_variables) > start) {
+		ScopeVariable* variable = &scope_variables[buf_len(scope_variables) - 1];
+		innermost_variables[variable->var->var_decl.identifier->symbol] =
+			variable->shadowed;
+		buf_pop(scope_variables);
+	}
+	buf_pop(scope_starts);
 }
 
 static void add_variable_to_scope(Stmt* var) {
-	buf_push(current_scope->variables, var);
+	u32 name = var->var_decl.identifier->symbol;
+	assert(name < symbol_count);
+	ScopeVariable variable;
+	variable.var = var;
+	variable.shadowed = innermost_variables[name];
+	buf_push(scope_variables, variable);
+	innermost_variables[name] = buf_len(scope_variables);
+}
+
+static ScopeVariable* find_variable(Token* identifier) {
+	assert(identifier->symbol < symbol_count);
+	u64 idx = innermost_variables[identifier->symbol];
+	return idx ? &scope_variables[idx - 1] : null;
+}
+
+static Stmt* lookup_name(Stmt** names, Token* identifier) {
+	assert(identifier->symbol < symbol_count);
+	return names[identifier->symbol];
 }
@@ -1,8 +1,217 @@
+#define _DEFAULT_SOURCE
 #include <ether/ether.h>
 
-/* the loader's job is to generate an object file
- * given a source file path */
-error_code loader_load(Loader* loader, char* fpath, char* obj_fpath) {
-	loader->fpath = fpath;
-	loader->obj_fpath = obj_fpath;	
+/* the loader turns a source file and everything it loads, directly or
+ * through other files, into modules. a module is keyed by the
+ * canonical path of its file, so a file that is loaded from many
+ * places (or through different relative paths) is lexed and parsed
+ * only once and shared by all of them. modules are loaded depth
+ * first; a 'load' of a module that is still on the 'loading' stack
+ * is a circular load. with a 'cache_dir', a module whose source has
+ * not changed since it was last compiled is read back from the ast
+ * cache instead of being lexed and parsed again. that is all the cache
+ * saves: top-level names are global across modules, so a change to
+ * one module can change what an unchanged one links to, and the
+ * linker and resolve still run over every module. */
+
+static void load_module(Loader*, Module*, Token*);
+static error_code parse_module(Loader*, Module*);
+static Module* load_path(Loader*, Module*, Token*);
+static Module* new_module(Loader*, char*, SourceFile*);
+static char* canonical_path(char*);
+static void circular_load_error(Loader*, Module*, Token*);
+static u64 hash_contents(SourceFile*);
+
+void loader_init(Loader* loader, char* cache_dir) {
+	memset(loader, 0, sizeof(Loader));
+	loader->cache_dir = cache_dir;
+}
+
+Module* loader_load(Loader* loader, SourceFile* file, error_code* out_error_code) {
+	char* fpath = canonical_path(file->fpath);
+	if (!fpath) fpath = str_intern(file->fpath);
+
+	Module* module = new_module(loader, fpath, file);
+	load_module(loader, module, null);
+
+	if (out_error_code) *out_error_code = loader->error_occured;
+	return module;
+}
+
+Stmt** loader_stmts(Loader* loader) {
+	Stmt** stmts = null;
+	for (u64 i = 0; i < buf_len(loader->order); ++i) {
+		Module* module = loader->order[i];
+		for (u64 s = 0; s < buf_len(module->stmts); ++s) {
+			buf_push(stmts, module->stmts[s]);
+		}
+	}
+
+	Stmt** result = (Stmt**)arena_buf_copy(&loader->arena, stmts,
+										   buf_len(stmts), sizeof(Stmt*));
+	buf_free(stmts);
+	return result;
+}
+
+/* the compact form is only built here, one module at a time, so it
+ * never lives next to the whole tree for long. a cache that cannot be
+ * written only costs the next compile time, so failures are ignored */
+void loader_save_cache(Loader* loader) {
+	for (u64 i = 0; i < buf_len(loader->order); ++i) {
+		Module* module = loader->order[i];
+		if (!module->unsaved) continue;
+		FlatAst ast;
+		flat_ast_build(&ast, module->stmts);
+		ast_cache_write(loader->cache_dir, module->srcfile, module->hash,
+						&ast, module->loads);
+		flat_ast_free(&ast);
+		module->unsaved = false;
+	}
+}
+
+void loader_free(Loader* loader) {
+	for (u64 i = 0; i < loader->modules.cap; ++i) {
+		if (!loader->modules.keys[i]) continue;
+		Module* module = (Module*)loader->modules.values[i];
+		ether_close_file(module->srcfile);
+		buf_free(module->loads);
+		buf_free(module->deps);
+		free(module);
+	}
+	map_free(&loader->modules);
+	buf_free(loader->order);
+	buf_free(loader->loading);
+	arena_free(&loader->arena);
+}
+
+static void load_module(Loader* loader, Module* module, Token* load) {
+	LoadFrame frame;
+	frame.module = module;
+	frame.load = load;
+	buf_push(loader->loading, frame);
+
+	error_code err = ETHER_SUCCESS;
+	if (!loader->cache_dir ||
+		!ast_cache_read(loader->cache_dir, module->srcfile, module->hash,
+						&loader->arena, &module->stmts, &module->loads)) {
+		err = parse_module(loader, module);
+	}
+
+	if (err) {
+		module->state = MODULE_FAILED;
+		loader->error_occured = ETHER_ERROR;
+	}
+	else {
+		for (u64 i = 0; i < buf_len(module->loads); ++i) {
+			Module* dep = load_path(loader, module, module->loads[i]);
+			if (dep) buf_push(module->deps, dep);
+		}
+		module->state = MODULE_LOADED;
+		buf_push(loader->order, module);
+	}
+	buf_pop(loader->loading);
+}
+
+/* a module with parse warnings is not cached, so that the warnings
+ * show up again on the next compile */
+static error_code parse_module(Loader* loader, Module* module) {
+	Parser parser;
+	Lexer lexer;
+	error_code err = ETHER_SUCCESS;
+	module->stmts = parser_run(&parser, &lexer, &loader->arena,
+							   module->srcfile, &err);
+	token_store_free(&lexer.tokens);
+	module->loads = parser.loads;
+
+	module->unsaved = !err && loader->cache_dir && parser.warning_count == 0;
+	return err;
+}
+
+/* 'load' paths are relative to the directory of the loading file */
+static Module* load_path(Loader* loader, Module* from, Token* load) {
+	char* from_fpath = from->srcfile->fpath;
+	char* last_forward_slash = strrchr(from_fpath, '/'); /* TODO: change to '\' in windows */
+	int dir_len = last_forward_slash ? (int)(last_forward_slash - from_fpath + 1) : 0;
+	char* target_fpath = null;
+	buf_printf(target_fpath, "%.*s%s", dir_len, from_fpath, load->lexeme);
+
+	Module* module = null;
+	SourceFile* file = null;
+	char* fpath = canonical_path(target_fpath);
+	if (fpath) {
+		module = (Module*)map_get(&loader->modules, (u64)fpath);
+		if (!module) file = ether_read_file(target_fpath);
+	}
+
+	if (module) {
+		if (module->state == MODULE_LOADING) {
+			circular_load_error(loader, module, load);
+		}
+	}
+	else if (!file) {
+		diag_report(DIAG_ERROR, load->srcfile, load->line, load->column,
+					"cannot find \"%s\" (relative_to_working_dir: \"%s\");",
+					load->lexeme, target_fpath);
+		loader->error_occured = ETHER_ERROR;
+	}
+	else {
+		file->fpath = str_intern(target_fpath);
+		module = new_module(loader, fpath, file);
+		load_module(loader, module, load);
+	}
+
+	buf_free(target_fpath);
+	return module;
+}
+
+static Module* new_module(Loader* loader, char* fpath, SourceFile* file) {
+	Module* module = (Module*)malloc(sizeof(Module));
+	assert(module);
+	module->fpath = fpath;
+	module->hash = hash_contents(file);
+	module->srcfile = file;
+	module->stmts = null;
+	module->loads = null;
+	module->deps = null;
+	module->state = MODULE_LOADING;
+	module->unsaved = false;
+	map_put(&loader->modules, (u64)fpath, (u64)module);
+	return module;
+}
+
+/* interned, so that paths can be compared and used as map keys by
+ * pointer; null if the file does not exist */
+static char* canonical_path(char* fpath) {
+	char* resolved = realpath(fpath, null);
+	if (!resolved) return null;
+
+	char* interned = str_intern(resolved);
+	free(resolved);
+	return interned;
+}
+
+/* 'module' is on the loading stack; every module above it was loaded
+ * on the way from 'module' back to itself */
+static void circular_load_error(Loader* loader, Module* module, Token* load) {
+	diag_report(DIAG_ERROR, load->srcfile, load->line, load->column,
+				"circular load of \"%s\";", module->srcfile->fpath);
+
+	u64 i = buf_len(loader->loading);
+	while (i > 0 && loader->loading[i - 1].module != module) --i;
+	for (; i < buf_len(loader->loading); ++i) {
+		Token* t = loader->loading[i].load;
+		diag_report(DIAG_NOTE, t->srcfile, t->line, t->column,
+					"\"%s\" is loaded here", loader->loading[i].module->srcfile->fpath);
+	}
+	loader->error_occured = ETHER_ERROR;
+}
+
+/* FNV-1a */
+static u64 hash_contents(SourceFile* file) {
+	u64 hash = 0xcbf29ce484222325ull;
+	for (u64 i = 0; i < file->len; ++i) {
+		hash ^= (uchar)file->contents[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
 }
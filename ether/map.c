@@ -0,0 +1,80 @@
+#include <ether/ether.h>
+
+#define MAP_MIN_CAP 16
+
+/* open-addressing (linear probing) hash map from non-zero u64 keys to
+ * u64 values; pointers and interned strings are used as keys directly */
+
+static u64 hash_key(u64);
+static void map_grow(Map*);
+
+u64 map_get(Map* map, u64 key) {
+	assert(key);
+	if (map->len == 0) return 0;
+
+	u64 i = hash_key(key) & (map->cap - 1);
+	for (;;) {
+		if (map->keys[i] == key) return map->values[i];
+		if (!map->keys[i]) return 0;
+		i = (i + 1) & (map->cap - 1);
+	}
+}
+
+void map_put(Map* map, u64 key, u64 value) {
+	assert(key);
+	if (2 * map->len >= map->cap) {
+		map_grow(map);
+	}
+
+	u64 i = hash_key(key) & (map->cap - 1);
+	for (;;) {
+		if (!map->keys[i]) {
+			map->keys[i] = key;
+			map->values[i] = value;
+			++map->len;
+			return;
+		}
+		if (map->keys[i] == key) {
+			map->values[i] = value;
+			return;
+		}
+		i = (i + 1) & (map->cap - 1);
+	}
+}
+
+void map_free(Map* map) {
+	free(map->keys);
+	free(map->values);
+	map->keys = null;
+	map->values = null;
+	map->len = 0;
+	map->cap = 0;
+}
+
+/* pointers are aligned and interned strings are close together, so
+ * the key bits are mixed before they pick a slot */
+static u64 hash_key(u64 key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	return key;
+}
+
+static void map_grow(Map* map) {
+	u64 new_cap = CLAMP_MIN(map->cap * 2, MAP_MIN_CAP);
+	Map new_map;
+	new_map.keys = (u64*)calloc(new_cap, sizeof(u64));
+	new_map.values = (u64*)malloc(new_cap * sizeof(u64));
+	assert(new_map.keys && new_map.values);
+	new_map.len = 0;
+	new_map.cap = new_cap;
+
+	for (u64 i = 0; i < map->cap; ++i) {
+		if (map->keys[i]) {
+			map_put(&new_map, map->keys[i], map->values[i]);
+		}
+	}
+
+	map_free(map);
+	*map = new_map;
+}
@@ -1,7 +1,25 @@
+#define _DEFAULT_SOURCE
 #include <ether/ether.h>
-
-static void parser_destroy(Parser*);
-
+#include <pthread.h>
+#include <unistd.h>
+
+/* files are only split when every chunk gets at least this much */
+#define PARSER_PARALLEL_MIN_CHUNK (128 * 1024)
+
+typedef struct {
+	Parser parser;
+	Lexer lexer;
+	Arena arena;
+	pthread_t thread;
+} ParseChunk;
+
+static uint thread_count = 1;
+
+static void parser_init(Parser*, Lexer*, Arena*, SourceFile*);
+static void parse_decls(Parser*);
+static bool parse_parallel(Parser*, Lexer*, Arena*, SourceFile*);
+static void* parse_chunk(void*);
+static u64 count_newlines(char*, char*);
 static Stmt* parse_decl(Parser*);
 static Stmt* parse_stmt(Parser*);
 static Stmt* parse_struct(Parser*, Token*);
@@ -12,16 +30,16 @@ static void parse_load_stmt(Parser*);
 static Stmt* parse_var_decl(Parser*, DataType*, Token*, bool);
 static Stmt* parse_extern_stmt(Parser*);
 static Stmt* parse_if_stmt(Parser*);
-static void parse_if_branch(Parser*, Stmt*, IfBranchType);
+static IfBranch* parse_if_branch(Parser*, IfBranchType);
 static Stmt* parse_for_stmt(Parser*);
 static Stmt* parse_while_stmt(Parser*);
 static Stmt* parse_return_stmt(Parser*, Token*);
 static Stmt* parse_expr_stmt(Parser*);
 
 static Expr* parse_expr(Parser*);
-static Expr* parse_dot_access_expr(Parser*);
+static Expr* parse_dot_access_expr(Parser*, Expr*);
 static Expr* parse_primary_expr(Parser*);
-static Expr* parse_func_call_expr(Parser*);
+static Token* parse_callee(Parser*);
 
 static Expr* make_dot_access_expr(Parser*, Expr*, Token*);
 static Expr* make_number_expr(Parser*, Token*);
@@ -31,11 +49,13 @@ static Expr* make_bool_expr(Parser*, Token*);
 static Expr* make_string_expr(Parser*, Token*);
 static Expr* make_variable_expr(Parser*, Token*);
 static Expr* make_func_call_expr(Parser*, Token*, Expr**);
+static ExprType call_expr_type(Token*);
 
 static bool match_token_type(Parser*, TokenType);
 inline static bool match_left_bracket(Parser*);
 inline static bool match_right_bracket(Parser*);
-static bool match_keyword(Parser*, char*);
+static bool match_keyword(Parser*, KeywordType);
+static bool match_keyword_range(Parser*, KeywordType, KeywordType);
 static DataType* match_data_type(Parser*);
 static bool peek(Parser*, TokenType);
 static void expect_token_type(Parser*, TokenType, const char*, ...);
@@ -48,40 +68,99 @@ static DataType* consume_data_type(Parser*);
 
 static void goto_next_token(Parser*);
 static void goto_previous_token(Parser*);
+static Token* token_at(Parser*, u64);
+static Token pull_token(Parser*);
 static Token* current(Parser*);
 static Token* previous(Parser*);
+static Token* next(Parser*);
+static Token* retain_token(Parser*, Token*);
+
+/* child lists are collected on 'p->scratch', used as a stack */
+typedef struct {
+	u64 mark;
+	u64 len;
+} ListBuilder;
+
+/* a call whose arguments are being parsed; 'error_count' is taken
+ * before every argument */
+struct ExprFrame {
+	Token* callee;
+	ListBuilder args;
+	uint error_count;
+};
+
+static ListBuilder list_begin(Parser*);
+static void list_push(Parser*, ListBuilder*, void*);
+static void* list_end(Parser*, ListBuilder*);
+static TokenType current_type(Parser*);
+static KeywordType current_keyword(Parser*);
 
 static void error_at_current(Parser*, const char*, ...);
 static void error(Parser*, Token*, const char*, ...);
 static void warning_at_previous(Parser*, const char*, ...);
-static void warning(Parser*, Token*, const char*, ...);
+static void verror(Parser*, Token*, const char*, va_list);
+static void vwarning(Parser*, Token*, const char*, va_list);
 static void sync_to_next_statement(Parser*);
 
-static void init_built_in_data_types(Parser*);
-static void init_operator_keywords(Parser*);
-
 #define CUR_ERROR uint current_error_count = p->error_count
 #define EXIT_ERROR if (p->error_count > current_error_count) return
 
 #define CHECK_EOF(x) \
-if (current(p)->type == TOKEN_EOF) { \
+if (current_type(p) == TOKEN_EOF) { \
 	error_at_current(p, "end of file while parsing function body; did you forget a ']'?"); \
 	return (x); \
 }
 
-#define CHECK_EOF_VOID_RETURN \
-if (current(p)->type == TOKEN_EOF) { \
-	error_at_current(p, "end of file while parsing function body; did you forget a ']'?"); \
-	return; \
+/* 0 picks the number of online CPUs */
+void parser_set_thread_count(uint count) {
+	if (count == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		count = cpus > 0 ? (uint)cpus : 1;
+	}
+	thread_count = count;
 }
 
-Stmt** parser_run(Parser* p, Token** tokens_buf, SourceFile* file, error_code* out_error_code) {
-	p->tokens = tokens_buf;
-	p->tokens_len = buf_len(p->tokens);
+uint parser_thread_count(void) {
+	return thread_count;
+}
+
+/* tokens are pulled from 'lexer' as the parser needs them and kept in
+ * a small ring ('window') that covers the few tokens behind and ahead
+ * of 'idx'. a Token* into the window is only good until the parser
+ * moves on, so everything the AST keeps goes through retain_token.
+ * the whole tree, retained tokens included, is allocated from 'arena'. */
+Stmt** parser_run(Parser* p, Lexer* lexer, Arena* arena,
+				  SourceFile* file, error_code* out_error_code) {
+	lexer_start(lexer, file);
+	if (thread_count > 1 &&
+		file->len >= 2 * PARSER_PARALLEL_MIN_CHUNK &&
+		parse_parallel(p, lexer, arena, file)) {
+		if (out_error_code) *out_error_code = ETHER_SUCCESS;
+		return p->stmts;
+	}
+
+	/* parse errors after a lex error are mostly caused by it, so the
+	 * parser's diagnostics are held until the lexer has seen the whole
+	 * file (parse_decls pulls tokens up to EOF) and only written if it
+	 * found no error. the lexer's own are written right away. */
+	parser_init(p, lexer, arena, file);
+	diag_defer(true);
+	parse_decls(p);
+	diag_flush_deferred(!lexer->error_occured);
+
+	if (out_error_code) *out_error_code = p->error_occured || lexer->error_occured;
+	return p->stmts;
+}
+
+static void parser_init(Parser* p, Lexer* lexer, Arena* arena,
+						SourceFile* file) {
+	p->lexer = lexer;
+	p->lexed = 0;
+	p->arena = arena;
+	p->scratch = null;
+	p->expr_frames = null;
 	p->stmts = null;
 	p->srcfile = file;
-	p->built_in_data_types = null;
-	p->operator_keywords = null;
 	p->idx = 0;
 	p->error_count = 0;
 	p->error_occured = false;
@@ -89,52 +168,169 @@ Stmt** parser_run(Parser* p, Token** tokens_buf, SourceFile* file, error_code* o
 	p->error_panic = false;
 	p->start_stmt_bracket = false;
 	p->current_function = null;
+	p->quiet = false;
+	p->warnings = null;
+	p->warning_count = 0;
+	p->loads = null;
+}
 
-	init_built_in_data_types(p);
-	init_operator_keywords(p);
+static void parse_decls(Parser* p) {
+	ListBuilder stmts = list_begin(p);
+	while (current_type(p) != TOKEN_EOF) {
+		/* a quiet parser's result is thrown away on any error */
+		if (p->quiet && (p->error_occured || p->lexer->error_occured)) break;
 
-	while (current(p)->type != TOKEN_EOF) {
 		Stmt* stmt = parse_decl(p);
-		if (stmt) buf_push(p->stmts, stmt);
+		if (stmt) list_push(p, &stmts, stmt);
 	}
-	if (out_error_code) *out_error_code = p->error_occured;
-	parser_destroy(p);
-	return p->stmts;
+	p->stmts = (Stmt**)list_end(p, &stmts);
+	buf_free(p->scratch);
+	buf_free(p->expr_frames);
 }
 
-void parser_destroy(Parser* p) {
-	buf_free(p->built_in_data_types);
+/* top-level forms do not depend on each other while parsing, so the
+ * file is split in front of lines that start with '[' and every chunk
+ * is lexed and parsed on its own thread, with its own lexer and arena.
+ * this is the only place the compiler lexes in parallel. the statement
+ * lists are joined in source order and the warnings reported in the
+ * same order, so the result is the same as a serial parse. a chunk that
+ * ran into any error, or whose range turned out to start inside a
+ * token, makes the whole attempt fail; the caller then parses the file
+ * serially, which also produces the diagnostics in their usual order. */
+static bool parse_parallel(Parser* p, Lexer* lexer, Arena* arena,
+						   SourceFile* file) {
+	uint max_chunks = (uint)MIN(thread_count,
+								file->len / PARSER_PARALLEL_MIN_CHUNK);
+	ParseChunk* chunks = (ParseChunk*)calloc(max_chunks, sizeof(ParseChunk));
+	assert(chunks);
+
+	char* contents = file->contents;
+	char* file_end = contents + file->len;
+	char* chunk_start = contents;
+	u64 line = 1;
+	uint chunk_count = 0;
+	for (uint i = 1; i <= max_chunks; ++i) {
+		char* chunk_end = file_end;
+		if (i < max_chunks) {
+			chunk_end = lexer_find_split(contents + file->len / max_chunks * i,
+										 file_end);
+		}
+		if (chunk_end <= chunk_start) continue;
+
+		ParseChunk* c = &chunks[chunk_count++];
+		lexer_start_range(&c->lexer, file, chunk_start, chunk_end, line);
+		parser_init(&c->parser, &c->lexer, &c->arena, file);
+		c->parser.quiet = true;
+		line += count_newlines(chunk_start, chunk_end);
+		chunk_start = chunk_end;
+	}
+
+	bool ok = chunk_count >= 2;
+	if (ok) {
+		for (uint i = 1; i < chunk_count; ++i) {
+			pthread_create(&chunks[i].thread, null, parse_chunk, &chunks[i].parser);
+		}
+		parse_chunk(&chunks[0].parser);
+		for (uint i = 1; i < chunk_count; ++i) {
+			pthread_join(chunks[i].thread, null);
+		}
+	}
+
+	for (uint i = 0; i < chunk_count && ok; ++i) {
+		ParseChunk* c = &chunks[i];
+		if (c->parser.error_occured || c->lexer.error_occured) ok = false;
+		if (i < chunk_count - 1 && !lexer_range_complete(&c->lexer)) ok = false;
+	}
+
+	if (ok) {
+		parser_init(p, lexer, arena, file);
+		Stmt** stmts = null;
+		for (uint i = 0; i < chunk_count; ++i) {
+			Parser* cp = &chunks[i].parser;
+			for (u64 s = 0; s < buf_len(cp->stmts); ++s) {
+				buf_push(stmts, cp->stmts[s]);
+			}
+			for (u64 l = 0; l < buf_len(cp->loads); ++l) {
+				buf_push(p->loads, cp->loads[l]);
+			}
+			for (u64 w = 0; w < buf_len(cp->warnings); ++w) {
+				Token* t = cp->warnings[w].token;
+				diag_report(DIAG_WARNING, t->srcfile, t->line, t->column,
+							"%s", cp->warnings[w].msg);
+			}
+			p->warning_count += cp->warning_count;
+			arena_merge(arena, &chunks[i].arena);
+		}
+		p->stmts = (Stmt**)arena_buf_copy(arena, stmts, buf_len(stmts),
+										  sizeof(Stmt*));
+		buf_free(stmts);
+	}
+
+	for (uint i = 0; i < chunk_count; ++i) {
+		Parser* cp = &chunks[i].parser;
+		for (u64 w = 0; w < buf_len(cp->warnings); ++w) {
+			buf_free(cp->warnings[w].msg);
+		}
+		buf_free(cp->warnings);
+		buf_free(cp->loads);
+		token_store_free(&chunks[i].lexer.tokens);
+		arena_free(&chunks[i].arena);
+	}
+	free(chunks);
+	return ok;
+}
+
+static void* parse_chunk(void* arg) {
+	parse_decls((Parser*)arg);
+	return null;
+}
+
+/* a chunk starts at the line after every newline in front of it; the
+ * lexer counts newlines inside strings as well, so this matches the
+ * lines of a serial parse */
+static u64 count_newlines(char* cur, char* end) {
+	u64 count = 0;
+	while (cur < end) {
+		cur = scan_line_end(cur, end);
+		if (cur >= end || *cur != '\n') break;
+		++count;
+		++cur;
+	}
+	return count;
 }
 
 /* only top level statements (functions, structs, var) */
 static Stmt* parse_decl(Parser* p) {
+	/* like parse_stmt, every form gets out of panic; otherwise the
+	 * errors below return without moving on and this never ends */
+	p->error_panic = false;
 	consume_left_bracket(p);
  
 	/* TODO: parser necessary data types and identifiers in functions
 	 * and leave this clean */
 	Stmt* stmt = null;
-	if (match_keyword(p, "struct")) {
+	if (match_keyword(p, KEYWORD_STRUCT)) {
 		Token* identifier = consume_identifier(p); /* TODO: to refactor */
 		stmt = parse_struct(p, identifier);
 	}
-	else if (match_keyword(p, "let")) {
+	else if (match_keyword(p, KEYWORD_LET)) {
 		DataType* type = consume_data_type(p); /* TODO: to refactor */
 		consume_colon(p);
 		Token* identifier = consume_identifier(p);
 		stmt = parse_var_decl(p, type, identifier, true);
 	}
-	else if (match_keyword(p, "defn")) {
+	else if (match_keyword(p, KEYWORD_DEFN)) {
 		bool public = false;
-		if (match_keyword(p, "pub")) public = true;
+		if (match_keyword(p, KEYWORD_PUB)) public = true;
 		stmt = parse_func(p, public);
 	}
-	else if (match_keyword(p, "decl")) {
+	else if (match_keyword(p, KEYWORD_DECL)) {
 		stmt = parse_func_decl(p);
 	}
-	else if (match_keyword(p, "extern")) {
+	else if (match_keyword(p, KEYWORD_EXTERN)) {
 		stmt = parse_extern_stmt(p);
 	}
-	else if (match_keyword(p, "load")) {
+	else if (match_keyword(p, KEYWORD_LOAD)) {
 		parse_load_stmt(p);
 		return null;
 	}
@@ -154,40 +350,40 @@ static Stmt* parse_stmt(Parser* p) {
 	p->start_stmt_bracket = false;
 
 	Stmt* stmt = null;
-	if (match_keyword(p, "let")) {
+	if (match_keyword(p, KEYWORD_LET)) {
 		DataType* dt = consume_data_type(p);
 		consume_colon(p);
 		Token* identifier = consume_identifier(p);
 		stmt = parse_var_decl(p, dt, identifier, false);
 	}
-	else if (match_keyword(p, "return")) {
-		stmt = parse_return_stmt(p, previous(p));
+	else if (match_keyword(p, KEYWORD_RETURN)) {
+		stmt = parse_return_stmt(p, retain_token(p, previous(p)));
 	}
-	else if (match_keyword(p, "if")) {
+	else if (match_keyword(p, KEYWORD_IF)) {
 		stmt = parse_if_stmt(p);
 	}
-	else if (match_keyword(p, "for")) {
+	else if (match_keyword(p, KEYWORD_FOR)) {
 		stmt = parse_for_stmt(p);
 	}
-	else if (match_keyword(p, "while")) {
+	else if (match_keyword(p, KEYWORD_WHILE)) {
 		stmt = parse_while_stmt(p);
 	}
-	else if (match_keyword(p, "elif") || match_keyword(p, "else")) {
+	else if (match_keyword(p, KEYWORD_ELIF) || match_keyword(p, KEYWORD_ELSE)) {
 		error(p, previous(p), "'%s' branch without preceding 'if' statement; "
 						  "did you mean 'if'?", previous(p)->lexeme);
 		return null;
 	}
-	else if (match_keyword(p, "struct")) {
+	else if (match_keyword(p, KEYWORD_STRUCT)) {
 		error(p, previous(p), "cannot define a type inside a function-scope; "
 						  "did you miss a ']'?");
 		return null;
 	}
-	else if (match_keyword(p, "defn")) {
+	else if (match_keyword(p, KEYWORD_DEFN)) {
 		error(p, previous(p), "cannot define a function inside a function-scope; "
 						  "did you miss a ']'?");
 		return null;
 	}
-	else if (match_keyword(p, "decl")) {
+	else if (match_keyword(p, KEYWORD_DECL)) {
 		error(p, previous(p), "cannot declare a function inside a function-scope; "
 						  "did you miss a ']'?");
 		return null;
@@ -201,14 +397,14 @@ static Stmt* parse_stmt(Parser* p) {
 	return stmt;
 }
 
-#define MAKE_STMT(x) Stmt* x = (Stmt*)malloc(sizeof(Stmt));
+#define MAKE_STMT(x) Stmt* x = (Stmt*)arena_alloc(p->arena, sizeof(Stmt));
 
 static Stmt* parse_struct(Parser* p, Token* identifier) {
-	Field** fields = null;
+	ListBuilder fields = list_begin(p);
 	if (!match_right_bracket(p)) {
 		do {
 			consume_left_bracket(p);
-			if (!match_keyword(p, "let")) {
+			if (!match_keyword(p, KEYWORD_LET)) {
 				/* TODO: refactor into function */
 				error(p, current(p), "expected 'let' keyword here: ");
 				continue;
@@ -217,10 +413,10 @@ static Stmt* parse_struct(Parser* p, Token* identifier) {
 			consume_colon(p);
 			Token* t = consume_identifier(p);
 
-			Field* f = (Field*)malloc(sizeof(Field));
+			Field* f = (Field*)arena_alloc(p->arena, sizeof(Field));
 			f->type = d;
 			f->identifier = t;
-			buf_push(fields, f);
+			list_push(p, &fields, f);
 			consume_right_bracket(p);
 			CHECK_EOF(null);
 		} while (!match_right_bracket(p));
@@ -229,7 +425,7 @@ static Stmt* parse_struct(Parser* p, Token* identifier) {
 	MAKE_STMT(new);
 	new->type = STMT_STRUCT;
 	new->struct_stmt.identifier = identifier;
-	new->struct_stmt.fields = fields;
+	new->struct_stmt.fields = (Field**)list_end(p, &fields);
 	return new;
 }
 
@@ -239,17 +435,17 @@ static Stmt* parse_func(Parser* p, bool public) {
 	if (header_parsing_error != ETHER_SUCCESS) return null;
 	p->current_function = new;
 
-	Stmt** body = null;
+	ListBuilder body = list_begin(p);
 	while (!match_right_bracket(p)) {
 		CUR_ERROR;
 		CHECK_EOF(null);
 		Stmt* stmt = parse_stmt(p);
-		if (stmt) buf_push(body, stmt);
+		if (stmt) list_push(p, &body, stmt);
 		EXIT_ERROR null;
 	}
 
 	new->type = STMT_FUNC;
-	new->func.body = body;
+	new->func.body = (Stmt**)list_end(p, &body);
 	new->func.public = public;
 	return new;
 }
@@ -260,16 +456,12 @@ static error_code parse_func_header(Parser* p, Stmt* stmt, bool is_function) {
 	Token* identifier = consume_identifier(p);
 	consume_left_bracket(p);
 
-	Stmt** params = null;
+	ListBuilder params = list_begin(p);
 	bool has_params = true;
 
-	if (current(p)->type == TOKEN_KEYWORD) {
-		if (str_intern(current(p)->lexeme) ==
-			str_intern("void")) {
-
-			if (p->idx < p->tokens_len-1 && p->tokens[p->idx+1]->type == TOKEN_RIGHT_BRACKET) {
-				has_params = false;
-			}
+	if (current_keyword(p) == KEYWORD_VOID) {
+		if (next(p)->type == TOKEN_RIGHT_BRACKET) {
+			has_params = false;
 		}
 	}
 
@@ -296,7 +488,7 @@ static error_code parse_func_header(Parser* p, Stmt* stmt, bool is_function) {
 			param->var_decl.identifier = p_name;
 			param->var_decl.initializer = null;
 			param->var_decl.is_global_var = false;
-			buf_push(params, param);
+			list_push(p, &params, param);
 
 			EXIT_ERROR ETHER_ERROR;
 			CHECK_EOF(ETHER_ERROR);
@@ -305,7 +497,7 @@ static error_code parse_func_header(Parser* p, Stmt* stmt, bool is_function) {
 
 	stmt->func.type = type;
 	stmt->func.identifier = identifier;
-	stmt->func.params = params;
+	stmt->func.params = (Stmt**)list_end(p, &params);
 	stmt->func.is_function = is_function;
 	return ETHER_SUCCESS;
 }
@@ -321,31 +513,16 @@ static Stmt* parse_func_decl(Parser* p) {
 	return new;
 }
 
+/* the file is not read here; the loader goes through 'p->loads'
+ * once the whole file is parsed */
 static void parse_load_stmt(Parser* p) {
-	Token* fpath = null;
+	CUR_ERROR;
 	expect_token_type(p, TOKEN_STRING, "expected string here: ");
-	fpath = previous(p);
+	Token* fpath = retain_token(p, previous(p));
 	consume_right_bracket(p);
+	EXIT_ERROR;
 
-	echar* cur_fpath = estr_create(p->srcfile->fpath);
-	u64 last_forward_slash = estr_find_last_of(cur_fpath, '/'); /* TODO: change to '\' in windows */
-	echar* target_fpath = null;
-	target_fpath = estr_sub(cur_fpath, 0, last_forward_slash + 1);
-	estr_append(target_fpath, fpath->lexeme);
-
-	SourceFile* file = ether_read_file(target_fpath);
-	if (!file) {
-		error(p, fpath,
-			  "cannot find \"%s\" (relative_to_working_dir: \"%s\");",
-			  fpath->lexeme, target_fpath);
-		return;
-	}
-
-	// Loader loader;
-	// error_code err = loader_load(&loader, file, p->stmts);
-	// if (err) {
-		/* TODO: what to do here */
-	// }
+	buf_push(p->loads, fpath);
 }
 
 static Stmt* parse_var_decl(Parser* p, DataType* d, Token* t, bool is_global_var) {
@@ -387,83 +564,67 @@ static Stmt* parse_if_stmt(Parser* p) {
 	MAKE_STMT(new);
 	new->type = STMT_IF;
 
-	parse_if_branch(p, new, IF_IF_BRANCH);
+	new->if_stmt.if_branch = parse_if_branch(p, IF_IF_BRANCH);
 
+	ListBuilder elif_branches = list_begin(p);
 	for (;;) {
-		if (p->tokens[p->idx]->type == TOKEN_LEFT_BRACKET) {
-			if ((p->idx+1) < p->tokens_len && p->tokens[p->idx+1]->type == TOKEN_KEYWORD) {
-				if (str_intern(p->tokens[p->idx+1]->lexeme) ==
-					str_intern("elif")) {
-					goto_next_token(p);
-					goto_next_token(p);
-					parse_if_branch(p, new, IF_ELIF_BRANCH);
-				} else break;
+		if (current_type(p) == TOKEN_LEFT_BRACKET) {
+			if (next(p)->keyword == KEYWORD_ELIF) {
+				goto_next_token(p);
+				goto_next_token(p);
+				IfBranch* branch = parse_if_branch(p, IF_ELIF_BRANCH);
+				if (branch) list_push(p, &elif_branches, branch);
 			} else break;
 		} else break;
 	}
+	new->if_stmt.elif_branch = (IfBranch**)list_end(p, &elif_branches);
 
-	if (p->tokens[p->idx]->type == TOKEN_LEFT_BRACKET) {
-		if ((p->idx+1) < p->tokens_len && p->tokens[p->idx+1]->type == TOKEN_KEYWORD) {
-			if (str_intern(p->tokens[p->idx+1]->lexeme) ==
-				str_intern("else")) {
-				goto_next_token(p);
-				goto_next_token(p);
-				parse_if_branch(p, new, IF_ELSE_BRANCH);
-			}
+	if (current_type(p) == TOKEN_LEFT_BRACKET) {
+		if (next(p)->keyword == KEYWORD_ELSE) {
+			goto_next_token(p);
+			goto_next_token(p);
+			new->if_stmt.else_branch = parse_if_branch(p, IF_ELSE_BRANCH);
 		}
 	}
 
 	return new;
 }
 
-static void parse_if_branch(Parser* p, Stmt* if_stmt, IfBranchType type) {
+static IfBranch* parse_if_branch(Parser* p, IfBranchType type) {
 	Expr* cond = null;
 	if (type != IF_ELSE_BRANCH) {
 		cond = parse_expr(p);
 	}
 
-	Stmt** body = null;
+	ListBuilder body = list_begin(p);
 	while (!match_right_bracket(p)) {
 		CUR_ERROR;
 		Stmt* stmt = parse_stmt(p);
-		if (stmt) buf_push(body, stmt);
-		EXIT_ERROR;
-		CHECK_EOF_VOID_RETURN;
+		if (stmt) list_push(p, &body, stmt);
+		EXIT_ERROR null;
+		CHECK_EOF(null);
 	}
 
-	IfBranch* branch = (IfBranch*)malloc(sizeof(IfBranch));
+	IfBranch* branch = (IfBranch*)arena_alloc(p->arena, sizeof(IfBranch));
 	branch->cond = cond;
-	branch->body = body;
-
-	switch (type) {
-		case IF_IF_BRANCH: {
-			if_stmt->if_stmt.if_branch = branch;
-		} break;
-
-		case IF_ELIF_BRANCH: {
-			buf_push(if_stmt->if_stmt.elif_branch, branch);
-		} break;
-
-		case IF_ELSE_BRANCH: {
-			if_stmt->if_stmt.else_branch = branch;
-		} break;
-	}
+	branch->body = (Stmt**)list_end(p, &body);
+	return branch;
 }
 
 static Stmt* parse_for_stmt(Parser* p) {
 	Token* identifier = consume_identifier(p);
-	if (!match_keyword(p, "to")) {
+	if (!match_keyword(p, KEYWORD_TO)) {
 		error(p, current(p), "expected 'to' keyword here: ");
 		return null;
 	}
 
 	Expr* to = parse_expr(p);
 
-	Stmt** body = null;
+	ListBuilder body = list_begin(p);
 	while (!match_right_bracket(p)) {
 		CUR_ERROR;
 		Stmt* stmt = parse_stmt(p);
-		if (stmt) buf_push(body, stmt);
+		if (stmt) list_push(p, &body, stmt);
 		EXIT_ERROR null;
 		CHECK_EOF(null);
 	}
@@ -479,18 +640,18 @@ static Stmt* parse_for_stmt(Parser* p) {
 	new->type = STMT_FOR;
 	new->for_stmt.counter = counter;
 	new->for_stmt.to = to;
-	new->for_stmt.body = body;
+	new->for_stmt.body = (Stmt**)list_end(p, &body);
 	return new;
 }
 
 static Stmt* parse_while_stmt(Parser* p) {
 	Expr* cond = parse_expr(p);
 
-	Stmt** body = null;
+	ListBuilder body = list_begin(p);
 	while (!match_right_bracket(p)) {
 		CUR_ERROR;
 		Stmt* stmt = parse_stmt(p);
-		if (stmt) buf_push(body, stmt);
+		if (stmt) list_push(p, &body, stmt);
 		EXIT_ERROR null;
 		CHECK_EOF(null);
 	}
@@ -498,7 +659,7 @@ static Stmt* parse_while_stmt(Parser* p) {
 	MAKE_STMT(new);
 	new->type = STMT_WHILE;
 	new->while_stmt.cond = cond;
-	new->while_stmt.body = body;
+	new->while_stmt.body = (Stmt**)list_end(p, &body);
 	return new;
 }
 
@@ -525,41 +686,92 @@ static Stmt* parse_expr_stmt(Parser* p) {
 	return new;
 }
 
+/* calls nest without limit (generated code easily goes thousands
+ * deep), so instead of recursing on every '[' the open calls are kept
+ * on 'p->expr_frames'. the loop goes down to the next primary
+ * expression, then hands every finished expression to the innermost
+ * open call until one of them needs another argument. any error in an
+ * argument makes all the enclosing calls fail, just like returning
+ * null through the recursive calls would. */
 static Expr* parse_expr(Parser* p) {
-	return parse_dot_access_expr(p);
+	u64 base = buf_len(p->expr_frames);
+	for (;;) {
+		Expr* expr = null;
+		if (match_left_bracket(p)) {
+			Token* callee = parse_callee(p);
+			if (callee && !match_right_bracket(p)) {
+				ExprFrame frame;
+				frame.callee = callee;
+				frame.args = list_begin(p);
+				frame.error_count = p->error_count;
+				buf_push(p->expr_frames, frame);
+				continue;
+			}
+			if (callee) expr = make_func_call_expr(p, callee, null);
+		}
+		else {
+			expr = parse_primary_expr(p);
+		}
+
+		while (buf_len(p->expr_frames) > base) {
+			expr = parse_dot_access_expr(p, expr);
+			ExprFrame* frame = &p->expr_frames[buf_len(p->expr_frames) - 1];
+			if (expr) list_push(p, &frame->args, expr);
+
+			if (current_type(p) == TOKEN_EOF) {
+				error_at_current(p, "end of file while parsing function body; "
+								 "did you forget a ']'?");
+				expr = null;
+			}
+			else if (p->error_count > frame->error_count) {
+				expr = null;
+			}
+			else if (match_right_bracket(p)) {
+				expr = make_func_call_expr(p, frame->callee,
+										   (Expr**)list_end(p, &frame->args));
+			}
+			else {
+				/* on to the next argument */
+				frame->error_count = p->error_count;
+				break;
+			}
+			buf_pop(p->expr_frames);
+		}
+
+		if (buf_len(p->expr_frames) == base) {
+			return parse_dot_access_expr(p, expr);
+		}
+	}
 }
 
-static Expr* parse_dot_access_expr(Parser* p) {
-	Expr* left = parse_primary_expr(p);
+static Expr* parse_dot_access_expr(Parser* p, Expr* left) {
 	while (match_token_type(p, TOKEN_DOT)) {
 		Token* right = consume_identifier(p);
-		left = make_dot_access_expr(p, left, right);
+		if (left) left = make_dot_access_expr(p, left, right);
 	}
 	return left;
 }
 
+/* everything but calls, which parse_expr takes care of */
 static Expr* parse_primary_expr(Parser* p) {
 	if (match_token_type(p, TOKEN_NUMBER)) {
-		return make_number_expr(p, previous(p));
+		return make_number_expr(p, retain_token(p, previous(p)));
 	}
 	else if (match_token_type(p, TOKEN_CHAR)) {
-		return make_char_expr(p, previous(p));
+		return make_char_expr(p, retain_token(p, previous(p)));
 	}
 	else if (match_token_type(p, TOKEN_STRING)) {
-		return make_string_expr(p, previous(p));
+		return make_string_expr(p, retain_token(p, previous(p)));
 	}
-	else if (match_keyword(p, "null")) {
-		return make_null_expr(p, previous(p));
+	else if (match_keyword(p, KEYWORD_NULL)) {
+		return make_null_expr(p, retain_token(p, previous(p)));
 	}
-	else if (match_keyword(p, "true") ||
-			 match_keyword(p, "false")) {
-		return make_bool_expr(p, previous(p));
+	else if (match_keyword(p, KEYWORD_TRUE) ||
+			 match_keyword(p, KEYWORD_FALSE)) {
+		return make_bool_expr(p, retain_token(p, previous(p)));
 	}
 	else if (match_token_type(p, TOKEN_IDENTIFIER)) {
-		return make_variable_expr(p, previous(p));
-	}
-	else if (match_left_bracket(p)) {
-		return parse_func_call_expr(p);
+		return make_variable_expr(p, retain_token(p, previous(p)));
 	}
 	else {
 		error_at_current(p, "invalid syntax; expected identifier, "
@@ -569,9 +781,10 @@ static Expr* parse_primary_expr(Parser* p) {
 	return null;
 }
 
-static Expr* parse_func_call_expr(Parser* p) {
+/* the function or operator right after a call's '[' */
+static Token* parse_callee(Parser* p) {
 	Token* callee = null;
-	switch (current(p)->type) {
+	switch (current_type(p)) {
 		case TOKEN_IDENTIFIER:
 		case TOKEN_PLUS:
 		case TOKEN_MINUS:
@@ -583,42 +796,22 @@ static Expr* parse_func_call_expr(Parser* p) {
 		case TOKEN_LESS_EQUAL:
 		case TOKEN_GREATER:
 		case TOKEN_GREATER_EQUAL: {
-			callee = current(p);
+			callee = retain_token(p, current(p));
 			goto_next_token(p);
 		} break;
 
 		default: {
-			bool got_valid_operator_keyword = false;
-			for (u64 keyword = 0; keyword < buf_len(p->operator_keywords); ++keyword) {
-				if (match_keyword(p, p->operator_keywords[keyword])) {
-					callee = previous(p);
-					got_valid_operator_keyword = true;
-					break;
-				}
-			}
-
-			if (!got_valid_operator_keyword) {
+			if (!match_keyword_range(p, KEYWORD_SET, KEYWORD_AT)) {
 				error_at_current(p, "expected identifier or operator here:");
 				return null;
 			}
+			callee = retain_token(p, previous(p));
 		}
 	}
-
-	Expr** args = null;
-	if (!match_right_bracket(p)) {
-		do {
-			CUR_ERROR;
-			Expr* e = parse_expr(p);
-			if (e) buf_push(args, e);
-			CHECK_EOF(null);
-			EXIT_ERROR null;
-		} while (!match_right_bracket(p));
-	}
-
-	return make_func_call_expr(p, callee, args);
+	return callee;
 }
 
-#define MAKE_EXPR(x) Expr* x = (Expr*)malloc(sizeof(Expr));
+#define MAKE_EXPR(x) Expr* x = (Expr*)arena_alloc(p->arena, sizeof(Expr));
 
 static Expr* make_dot_access_expr(Parser* p, Expr* left, Token* right) {
 	MAKE_EXPR(new);
@@ -678,13 +871,45 @@ static Expr* make_variable_expr(Parser* p, Token* t) {
 
 static Expr* make_func_call_expr(Parser* p, Token* callee, Expr** args) {
 	MAKE_EXPR(new);
-	new->type = EXPR_FUNC_CALL;
+	new->type = call_expr_type(callee);
 	new->head = callee;
 	new->func_call.callee = callee;
 	new->func_call.args = args;
 	return new;
 }
 
+/* 'callee' is one that parse_callee() accepts */
+static ExprType call_expr_type(Token* callee) {
+	switch (callee->type) {
+		case TOKEN_PLUS:
+		case TOKEN_MINUS:
+		case TOKEN_STAR:
+		case TOKEN_SLASH:
+		case TOKEN_PERCENT:
+			return EXPR_ARITHMETIC;
+
+		case TOKEN_EQUAL:
+		case TOKEN_LESS:
+		case TOKEN_LESS_EQUAL:
+		case TOKEN_GREATER:
+		case TOKEN_GREATER_EQUAL:
+			return EXPR_COMPARISON;
+
+		case TOKEN_KEYWORD: {
+			switch (callee->keyword) {
+				case KEYWORD_SET: return EXPR_SET;
+				case KEYWORD_DEREF: return EXPR_DEREF;
+				case KEYWORD_ADDR: return EXPR_ADDR;
+				case KEYWORD_AT: return EXPR_AT;
+				default: break;
+			}
+		} break;
+
+		default: break;
+	}
+	return EXPR_FUNC_CALL;
+}
+
 static bool match_token_type(Parser* p, TokenType t) {
 	if (peek(p, t)) {
 		goto_next_token(p);
@@ -707,9 +932,20 @@ static bool match_right_bracket(Parser* p) {
 	return false;
 }
 
-static bool match_keyword(Parser* p, char* s) {
+static bool match_keyword(Parser* p, KeywordType k) {
 	if (peek(p, TOKEN_KEYWORD) &&
-		str_intern(current(p)->lexeme) == str_intern(s)) {
+		current_keyword(p) == k) {
+		goto_next_token(p);
+		return true;
+	}
+	return false;
+}
+
+/* matches any keyword in [first, last] */
+static bool match_keyword_range(Parser* p, KeywordType first, KeywordType last) {
+	if (peek(p, TOKEN_KEYWORD) &&
+		current_keyword(p) >= first &&
+		current_keyword(p) <= last) {
 		goto_next_token(p);
 		return true;
 	}
@@ -721,17 +957,13 @@ static DataType* match_data_type(Parser* p) {
 	bool matched_main_type = false;
 	if (match_token_type(p, TOKEN_IDENTIFIER)) {
 		matched_main_type = true;
-		new = (DataType*)malloc(sizeof(DataType));
-		new->type = previous(p);
+		new = (DataType*)arena_alloc(p->arena, sizeof(DataType));
+		new->type = retain_token(p, previous(p));
 	}
-	else {
-		for (uint i = 0; i < buf_len(p->built_in_data_types); ++i) {
-			if (match_keyword(p, p->built_in_data_types[i])) {
-				matched_main_type = true;
-				new = (DataType*)malloc(sizeof(DataType));
-				new->type = previous(p);
-			}
-		}
+	else if (match_keyword_range(p, KEYWORD_INT, KEYWORD_VOID)) {
+		matched_main_type = true;
+		new = (DataType*)arena_alloc(p->arena, sizeof(DataType));
+		new->type = retain_token(p, previous(p));
 	}
 
 	if (matched_main_type) {
@@ -746,11 +978,7 @@ static DataType* match_data_type(Parser* p) {
 }
 
 static bool peek(Parser* p, TokenType t) {
-	if (p->idx >= p->tokens_len) {
-		return false;
-	}
-
-	if (current(p)->type == t) {
+	if (current_type(p) == t) {
 		return true;
 	}
 	return false;
@@ -762,7 +990,7 @@ static void expect_token_type(Parser* p, TokenType t, const char* msg, ...) {
 	}
 	va_list ap;
 	va_start(ap, msg);
-	error_at_current(p, msg, ap);
+	verror(p, current(p), msg, ap);
 	va_end(ap);
 }
 
@@ -781,7 +1009,7 @@ inline static void consume_colon(Parser* p) {
 
 inline static Token* consume_identifier(Parser* p) {
 	expect_token_type(p, TOKEN_IDENTIFIER, "expected identifier here:");
-	return previous(p);
+	return retain_token(p, previous(p));
 }
 
 static DataType* consume_data_type(Parser* p) {
@@ -793,9 +1021,7 @@ static DataType* consume_data_type(Parser* p) {
 }
 
 static void goto_next_token(Parser* p) {
-	if (p->idx == 0 || (p->idx - 1) < p->tokens_len) {
-		++p->idx;
-	}
+	++p->idx;
 }
 
 static void goto_previous_token(Parser* p) {
@@ -804,42 +1030,102 @@ static void goto_previous_token(Parser* p) {
 	}
 }
 
-static Token* current(Parser* p) {
-	if (p->idx >= p->tokens_len) {
-		return null;
+/* pulls tokens up to 'idx' into the window; past EOF the EOF token
+ * keeps being returned */
+static Token* token_at(Parser* p, u64 idx) {
+	while (p->lexed <= idx) {
+		if (p->lexed > 0) {
+			Token* last = &p->window[(p->lexed - 1) & (PARSER_WINDOW_SIZE - 1)];
+			if (last->type == TOKEN_EOF) return last;
+		}
+		p->window[p->lexed & (PARSER_WINDOW_SIZE - 1)] = pull_token(p);
+		++p->lexed;
 	}
-	return p->tokens[p->idx];
+	assert(idx + PARSER_WINDOW_SIZE > p->lexed);
+	return &p->window[idx & (PARSER_WINDOW_SIZE - 1)];
+}
+
+/* a quiet parser runs on a chunk thread and defers nothing */
+static Token pull_token(Parser* p) {
+	if (p->quiet) return lexer_next(p->lexer);
+	diag_defer(false);
+	Token t = lexer_next(p->lexer);
+	diag_defer(true);
+	return t;
+}
+
+static Token* current(Parser* p) {
+	return token_at(p, p->idx);
 }
 
 static Token* previous(Parser* p) {
-	if (p->idx >= p->tokens_len + 1) {
-		return null;
-	}
-	return p->tokens[p->idx - 1];
+	return token_at(p, p->idx > 0 ? p->idx - 1 : 0);
+}
+
+static Token* next(Parser* p) {
+	return token_at(p, p->idx + 1);
+}
+
+static TokenType current_type(Parser* p) {
+	return current(p)->type;
+}
+
+static KeywordType current_keyword(Parser* p) {
+	return current(p)->keyword;
+}
+
+/* copies a window token somewhere it can outlive the window */
+static Token* retain_token(Parser* p, Token* t) {
+	Token* new = (Token*)arena_alloc(p->arena, sizeof(Token));
+	*new = *t;
+	return new;
+}
+
+static ListBuilder list_begin(Parser* p) {
+	ListBuilder l;
+	l.mark = buf_len(p->scratch);
+	l.len = 0;
+	return l;
+}
+
+/* a nested list that was abandoned by an early return leaves its
+ * elements behind on the stack; they are dropped here */
+static void list_push(Parser* p, ListBuilder* l, void* elem) {
+	if (p->scratch) buf__hdr(p->scratch)->len = l->mark + l->len;
+	buf_push(p->scratch, elem);
+	++l->len;
+}
+
+/* moves the list into the arena as an exact-size stretchy buffer; an
+ * empty list stays null, like an untouched buffer */
+static void* list_end(Parser* p, ListBuilder* l) {
+	void* list = arena_buf_copy(p->arena, p->scratch + l->mark,
+								l->len, sizeof(void*));
+	if (p->scratch) buf__hdr(p->scratch)->len = l->mark;
+	return list;
 }
 
 static void error_at_current(Parser* p, const char* msg, ...) {
 	va_list ap;
 	va_start(ap, msg);
-	error(p, current(p), msg, ap);
+	verror(p, current(p), msg, ap);
 	va_end(ap);
 }
 
 static void error(Parser* p, Token* t, const char* msg, ...) {
-	if (p->error_panic) return;
-	p->error_panic = true;
-
 	va_list ap;
 	va_start(ap, msg);
-	printf("%s:%ld:%d: error: ", t->srcfile->fpath, t->line, t->column);
-	char buf[512];
-	vsprintf(buf, msg, ap);
-	printf("%s", buf);
+	verror(p, t, msg, ap);
 	va_end(ap);
-	printf("\n");
+}
+
+static void verror(Parser* p, Token* t, const char* msg, va_list ap) {
+	if (p->error_panic) return;
+	p->error_panic = true;
 
-	print_file_line_with_info(t->srcfile, t->line);
-	print_marker_arrow_with_info_ln(t->srcfile, t->line, t->column);
+	if (!p->quiet) {
+		diag_vreport(DIAG_ERROR, t->srcfile, t->line, t->column, msg, ap);
+	}
 
 	sync_to_next_statement(p);
 
@@ -850,25 +1136,26 @@ static void error(Parser* p, Token* t, const char* msg, ...) {
 static void warning_at_previous(Parser* p, const char* msg, ...) {
 	va_list ap;
 	va_start(ap, msg);
-	warning(p, previous(p), msg, ap);
+	vwarning(p, previous(p), msg, ap);
 	va_end(ap);
 }
 
-static void warning(Parser* p, Token* t, const char* msg, ...) {
-	va_list ap;
-	va_start(ap, msg);
-	printf("%s:%ld:%d: warning: ", t->srcfile->fpath, t->line, t->column);
-	vprintf(msg, ap);
-	va_end(ap);
-	printf("\n");
-
-	print_file_line_with_info(t->srcfile, t->line);
-	print_marker_arrow_with_info_ln(t->srcfile, t->line, t->column);
+static void vwarning(Parser* p, Token* t, const char* msg, va_list ap) {
+	++p->warning_count;
+	if (p->quiet) {
+		DeferredWarning w;
+		w.token = retain_token(p, t);
+		w.msg = null;
+		buf_vprintf(w.msg, msg, ap);
+		buf_push(p->warnings, w);
+		return;
+	}
+	diag_vreport(DIAG_WARNING, t->srcfile, t->line, t->column, msg, ap);
 }
 
 static void sync_to_next_statement(Parser* p) {
 	while (true) {
-		if (current(p)->type == TOKEN_RIGHT_BRACKET) {
+		if (current_type(p) == TOKEN_RIGHT_BRACKET) {
 			if (p->error_bracket_counter == 0) {
 				/* stmt bkt */
 				goto_next_token(p);
@@ -879,12 +1166,12 @@ static void sync_to_next_statement(Parser* p) {
 				goto_next_token(p);
 			}
 		}
-		else if (current(p)->type == TOKEN_LEFT_BRACKET) {
+		else if (current_type(p) == TOKEN_LEFT_BRACKET) {
 			p->error_bracket_counter++;
 			goto_next_token(p);
 		}
 		else {
-			if (current(p)->type == TOKEN_EOF) {
+			if (current_type(p) == TOKEN_EOF) {
 				++p->error_count;
 				return;
 			}
@@ -892,28 +1179,3 @@ static void sync_to_next_statement(Parser* p) {
 		}
 	}
 }
-
-static void init_built_in_data_types(Parser* p) {
-	buf_push(p->built_in_data_types, str_intern("int"));
-
-	buf_push(p->built_in_data_types, str_intern("i8"));
-	buf_push(p->built_in_data_types, str_intern("i16"));
-	buf_push(p->built_in_data_types, str_intern("132"));
-	buf_push(p->built_in_data_types, str_intern("i64"));
-	
-	buf_push(p->built_in_data_types, str_intern("u8"));
-	buf_push(p->built_in_data_types, str_intern("u16"));
-	buf_push(p->built_in_data_types, str_intern("u32"));
-	buf_push(p->built_in_data_types, str_intern("u64"));
-
-	buf_push(p->built_in_data_types, str_intern("char"));
-	buf_push(p->built_in_data_types, str_intern("bool"));
-	buf_push(p->built_in_data_types, str_intern("void"));
-}
-
-static void init_operator_keywords(Parser* p) {
-	buf_push(p->operator_keywords, str_intern("set"));
-	buf_push(p->operator_keywords, str_intern("deref"));
-	buf_push(p->operator_keywords, str_intern("addr"));
-	buf_push(p->operator_keywords, str_intern("at"));
-}
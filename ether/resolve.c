@@ -7,20 +7,100 @@
 
 static Stmt** stmts;
 static Stmt** structs;
-static char** data_type_strings;
-static DataType** cloned_data_types;
+static u64* struct_indices; /* symbol -> index + 1 into 'structs' */
+static u32 symbol_count; /* when resolve_init ran */
 static bool error_occured;
 static bool persistent_error_occured;
 static uint error_count;
+static bool link_failed;
+static uint skip_depth; /* bodies resolve skips, see resolve_body */
 
 static DataType* int_data_type;
 static DataType* char_data_type;
 static DataType* string_data_type;
 static DataType* bool_data_type;
 static DataType* null_data_type;
-static ImplicitCastTypeMap* implicit_cast_types;
-static char** types_already_checked;
-static TypeSizeMap* type_sizes;
+
+#define BUILTIN_TYPE_COUNT (KEYWORD_VOID - KEYWORD_INT + 1)
+
+/* the size of a built-in type is also its alignment */
+static const u64 builtin_type_sizes[BUILTIN_TYPE_COUNT] = {
+	[KEYWORD_INT - KEYWORD_INT] = sizeof(int),
+	[KEYWORD_I8 - KEYWORD_INT] = sizeof(i8),
+	[KEYWORD_I16 - KEYWORD_INT] = sizeof(i16),
+	[KEYWORD_I32 - KEYWORD_INT] = sizeof(i32),
+	[KEYWORD_I64 - KEYWORD_INT] = sizeof(i64),
+	[KEYWORD_U8 - KEYWORD_INT] = sizeof(u8),
+	[KEYWORD_U16 - KEYWORD_INT] = sizeof(u16),
+	[KEYWORD_U32 - KEYWORD_INT] = sizeof(u32),
+	[KEYWORD_U64 - KEYWORD_INT] = sizeof(u64),
+	[KEYWORD_CHAR - KEYWORD_INT] = sizeof(char),
+	[KEYWORD_BOOL - KEYWORD_INT] = sizeof(u8),
+};
+
+/* the direct implicit casts between built-in types. casts work both
+ * ways and chain, so init_implicit_casts closes them into a matrix:
+ * bit b of 'implicit_casts[a]' is set if 'a' casts to 'b', with both
+ * counted from KEYWORD_INT */
+static const ImplicitCastTypeMap direct_implicit_casts[] = {
+	{ KEYWORD_INT, KEYWORD_CHAR },
+
+	{ KEYWORD_INT, KEYWORD_I8 },
+	{ KEYWORD_INT, KEYWORD_I16 },
+	{ KEYWORD_INT, KEYWORD_I32 },
+	{ KEYWORD_INT, KEYWORD_I64 },
+
+	{ KEYWORD_INT, KEYWORD_U8 },
+	{ KEYWORD_INT, KEYWORD_U16 },
+	{ KEYWORD_INT, KEYWORD_U32 },
+	{ KEYWORD_INT, KEYWORD_U64 },
+};
+static u32 implicit_casts[BUILTIN_TYPE_COUNT];
+
+/* every type resolve makes is interned: there is one CanonicalType per
+ * main type and pointer count, and its name is printed once. types
+ * from the tree are not canonical themselves, but any type can be
+ * mapped to its canonical one with intern_data_type */
+typedef struct {
+	DataType type;
+	Token main_type; /* 'type.type' points here */
+	char* name;
+} CanonicalType;
+
+static Arena type_arena;
+static Map canonical_types; /* symbol << 8 | pointer count -> CanonicalType* */
+
+/* an expression whose operands are being resolved, see resolve_expr */
+typedef struct {
+	Expr* expr;
+	u64 next; /* operands handed out so far */
+	uint error_mark;
+	DataType* first_type;
+	bool did_error_occur;
+	DataType* type;
+} ResolveFrame;
+
+static ResolveFrame* frames;
+
+typedef enum {
+	LAYOUT_NONE,
+	LAYOUT_STARTED,
+	LAYOUT_DONE,
+} LayoutState;
+
+/* structs are laid out as a C compiler would: every field at the next
+ * multiple of its alignment, and the size rounded up to the largest
+ * alignment of a field. a struct is laid out after the structs it
+ * holds by value, see layout_struct */
+typedef struct {
+	u64 size;
+	u64 align;
+	u64 next_field; /* the field to look at next while laying out */
+	LayoutState state;
+} StructLayout;
+
+static StructLayout* layouts; /* parallel to 'structs' */
+static u64* layout_stack;
 
 static void resolve_destroy(void);
 
@@ -34,28 +114,39 @@ static void resolve_for_stmt(Stmt*);
 static void resolve_while_stmt(Stmt*);
 static void resolve_return_stmt(Stmt*);
 static void resolve_expr_stmt(Stmt*);
+static void resolve_body(Stmt**, bool);
 
 static DataType* make_data_type(const char*, u8);
 static DataType* resolve_expr(Expr*);
-static DataType* resolve_dot_access_expr(Expr*);
-static DataType* resolve_func_call(Expr*);
-static DataType* resolve_set_expr(Expr*);
-static DataType* resolve_deref_expr(Expr*);
-static DataType* resolve_addr_expr(Expr*);
-static DataType* resolve_at_expr(Expr*); 
-static DataType* resolve_arithmetic_expr(Expr*);
-static DataType* resolve_comparison_expr(Expr*);
+static bool has_operands(Expr*);
+static DataType* resolve_leaf_expr(Expr*);
+static Expr* resolve_step(ResolveFrame*, DataType*);
+static void pop_frame(void);
+static Expr* resolve_dot_access_expr(ResolveFrame*, DataType*);
+static Expr* resolve_func_call(ResolveFrame*, DataType*);
+static Expr* resolve_set_expr(ResolveFrame*, DataType*);
+static Expr* resolve_deref_expr(ResolveFrame*, DataType*);
+static Expr* resolve_addr_expr(ResolveFrame*, DataType*);
+static Expr* resolve_at_expr(ResolveFrame*, DataType*); 
+static Expr* resolve_arithmetic_expr(ResolveFrame*, DataType*);
+static Expr* resolve_comparison_expr(ResolveFrame*, DataType*);
 static DataType* resolve_variable_expr(Expr*);
 static DataType* resolve_number_expr(Expr*);
 
 static void init_data_types(void);
-static Stmt* find_struct_by_name(char*);
+static Stmt* find_struct(Token*);
+static u64 lookup_struct_index(Token*);
+static void layout_structs(void);
+static void layout_struct(u64);
+static void finish_layout(u64);
+static void data_type_layout(DataType*, u64*, u64*);
 static DataType* make_data_type(const char*, u8);
-static DataType* clone_data_type(DataType*);
-static Token* make_token_from_string(const char*);
+static DataType* intern_data_type(Token*, u8);
+static Token make_token_from_string(const char*);
 static int data_type_match(DataType*, DataType*);
-static bool can_implicit_cast(char*, char*);
-static bool is_type_already_checked_for_cast(char*);
+static void init_implicit_casts(void);
+static bool can_implicit_cast(Token*, Token*);
+static u32 symbol_of(char*);
 static bool is_one_token(const char*, Token*, Token*);
 static char* data_type_to_string(DataType*);
 static DataType* get_smaller_type(DataType*, DataType*);
@@ -67,34 +158,58 @@ static void implicit_cast_warning(Token*, DataType*, DataType*);
 #define EXIT_ERROR(x) if (error_count > current_error) return x
 #define EXIT_ERROR_VOID_RETURN if (error_count > current_error) return
 
+/* the linker reports its errors as soon as it finds them. resolve's
+ * diagnostics are deferred, since they only count if the linker found
+ * nothing: a tree that does not link is not resolved any further. */
+#define LINK(x) \
+	do { \
+		diag_defer(false); \
+		x; \
+		diag_defer(true); \
+		link_failed = linker_error_occured(); \
+	} while (0)
+
+/* whether the node at hand is resolved or only linked */
+#define RESOLVING (!link_failed && skip_depth == 0)
+
 void resolve_init(Stmt** p_stmts, Stmt** p_structs) {
 	stmts = p_stmts;
 	structs = p_structs;
-	data_type_strings = null;
+	symbol_count = str_symbol_count();
+	struct_indices = (u64*)calloc(symbol_count, sizeof(u64));
+	assert(struct_indices);
+	for (u64 i = 0; i < buf_len(structs); ++i) {
+		struct_indices[structs[i]->struct_stmt.identifier->symbol] = i + 1;
+	}
 	error_occured = false;
 	persistent_error_occured = false;
 	error_count = 0;
-	types_already_checked = null;
+	link_failed = linker_error_occured();
+	skip_depth = 0;
 
 	init_data_types();
 }
 
+/* links and resolves the tree in a single walk: every node is linked
+ * right before it is resolved, so each name is bound once and used
+ * while the node is at hand */
 error_code resolve_run(void) {
+	diag_defer(true);
+	layout_structs();
 	resolve_file(stmts);
 	resolve_destroy();
+	diag_flush_deferred(!link_failed);
 
-	return persistent_error_occured || error_occured;
+	return link_failed || persistent_error_occured || error_occured;
 }
 
 static void resolve_destroy(void) {
-	for (u64 i = 0; i < buf_len(data_type_strings); ++i) {
-		free(data_type_strings[i]);
-	}
-	for (u64 i = 0; i < buf_len(cloned_data_types); ++i) {
-		free(cloned_data_types[i]);
-	}
-	buf_free(data_type_strings);
-	buf_free(cloned_data_types);
+	arena_free(&type_arena);
+	map_free(&canonical_types);
+	buf_free(frames);
+	free(struct_indices);
+	buf_free(layouts);
+	buf_free(layout_stack);
 }
 
 static void resolve_file(Stmt** p_stmts) {
@@ -109,6 +224,7 @@ static void resolve_stmt(Stmt* stmt) {
 		error_occured = false;
 	}
 	
+	LINK(link_stmt(stmt));
 	switch (stmt->type) {
 		case STMT_FUNC: resolve_func(stmt); break;
 		case STMT_VAR_DECL: resolve_var_decl(stmt); break;
@@ -119,6 +235,7 @@ static void resolve_stmt(Stmt* stmt) {
 		case STMT_EXPR: resolve_expr_stmt(stmt); break;
 		case STMT_STRUCT: break;	/* TODO: check */
 	}
+	LINK(link_stmt_end(stmt));
 }
 
 static void resolve_func(Stmt* stmt) {
@@ -126,9 +243,7 @@ static void resolve_func(Stmt* stmt) {
 		return;
 	}
 	
-	for (u64 i = 0; i < buf_len(stmt->func.body); ++i) {
-		resolve_stmt(stmt->func.body[i]);
-	}
+	resolve_body(stmt->func.body, false);
 }
 
 static void resolve_var_decl(Stmt* stmt) {
@@ -137,6 +252,7 @@ static void resolve_var_decl(Stmt* stmt) {
 		DataType* defined_type = stmt->var_decl.type;
 		DataType* initializer_type = resolve_expr(stmt->var_decl.initializer);
 		EXIT_ERROR_VOID_RETURN;
+		if (!RESOLVING) return;
 
 		int match = data_type_match(defined_type, initializer_type);
 		if (match == DATA_TYPE_NOT_MATCH) {
@@ -167,12 +283,16 @@ static void resolve_if_stmt(Stmt* stmt) {
 }
 
 static void resolve_if_branch(IfBranch* branch, IfBranchType type) {
+	bool skip_body = false;
 	if (type != IF_ELSE_BRANCH) {
 		CHECK_ERROR;
 		DataType* expr_type = resolve_expr(branch->cond);
-		EXIT_ERROR_VOID_RETURN;
+		skip_body = error_count > current_error;
 
-		int match = data_type_match(expr_type, bool_data_type);
+		int match = DATA_TYPE_MATCH;
+		if (!skip_body && RESOLVING) {
+			match = data_type_match(expr_type, bool_data_type);
+		}
 		if (match == DATA_TYPE_NOT_MATCH) {
 			error(branch->cond->head,
 				  "expected 'bool' data type in 'if' condition expression, "
@@ -185,18 +305,21 @@ static void resolve_if_branch(IfBranch* branch, IfBranchType type) {
 		}
 	}
 
-	for (u64 i = 0; i < buf_len(branch->body); ++i) {
-		resolve_stmt(branch->body[i]);
-	}
+	LINK(link_if_branch());
+	resolve_body(branch->body, skip_body);
+	LINK(link_if_branch_end());
 }
 
 static void resolve_for_stmt(Stmt* stmt) {
 	/* TODO: if for loop counter is modifiable, change this */
 	CHECK_ERROR;
 	DataType* to_type = resolve_expr(stmt->for_stmt.to);
-	EXIT_ERROR_VOID_RETURN;
+	bool skip_body = error_count > current_error;
 
-	int match = data_type_match(to_type, int_data_type);
+	int match = DATA_TYPE_MATCH;
+	if (!skip_body && RESOLVING) {
+		match = data_type_match(to_type, int_data_type);
+	}
 	if (match == DATA_TYPE_NOT_MATCH) {
 		error(stmt->for_stmt.to->head,
 			  "expected 'int' data type in 'for' target expression, "
@@ -208,17 +331,18 @@ static void resolve_for_stmt(Stmt* stmt) {
 				data_type_to_string(to_type));
 	}
 
-	for (u64 i = 0; i < buf_len(stmt->for_stmt.body); ++i) {
-		resolve_stmt(stmt->for_stmt.body[i]);
-	}
+	resolve_body(stmt->for_stmt.body, skip_body);
 }
 
 static void resolve_while_stmt(Stmt* stmt) {
 	CHECK_ERROR;
 	DataType* expr_type = resolve_expr(stmt->while_stmt.cond);
-	EXIT_ERROR_VOID_RETURN;
+	bool skip_body = error_count > current_error;
 
-	int match = data_type_match(expr_type, bool_data_type);
+	int match = DATA_TYPE_MATCH;
+	if (!skip_body && RESOLVING) {
+		match = data_type_match(expr_type, bool_data_type);
+	}
 	if (match == DATA_TYPE_NOT_MATCH) {
 		error(stmt->while_stmt.cond->head,
 			  "expected 'bool' data type in 'while' condition expression, "
@@ -230,9 +354,7 @@ static void resolve_while_stmt(Stmt* stmt) {
 				data_type_to_string(expr_type));
 	}
 
-	for (u64 i = 0; i < buf_len(stmt->while_stmt.body); ++i) {
-		resolve_stmt(stmt->while_stmt.body[i]);
-	}
+	resolve_body(stmt->while_stmt.body, skip_body);
 }
 
 static void resolve_return_stmt(Stmt* stmt) {
@@ -241,9 +363,13 @@ static void resolve_return_stmt(Stmt* stmt) {
 		stmt->return_stmt.function_referernced->func.type;
 	DataType* return_type = null;
 
+	if (!RESOLVING) {
+		if (stmt->return_stmt.expr) resolve_expr(stmt->return_stmt.expr);
+		return;
+	}
+
 	if (!stmt->return_stmt.expr) {
-		if (str_intern(function_type->type->lexeme) ==
-			str_intern("void") &&
+		if (function_type->type->keyword == KEYWORD_VOID &&
 			function_type->pointer_count == 0) {
 			match = DATA_TYPE_MATCH;
 		}
@@ -252,6 +378,7 @@ static void resolve_return_stmt(Stmt* stmt) {
 		CHECK_ERROR;
 		return_type = resolve_expr(stmt->return_stmt.expr);
 		EXIT_ERROR_VOID_RETURN;
+		if (!RESOLVING) return;
 
 		match = data_type_match(return_type, function_type);
 	}
@@ -285,25 +412,144 @@ static void resolve_expr_stmt(Stmt* stmt) {
 	resolve_expr(stmt->expr);
 }
 
-static DataType* resolve_expr(Expr* expr) {
+/* the body of a condition or loop with an error is not resolved, but
+ * it is still walked for the linker */
+static void resolve_body(Stmt** body, bool skip) {
+	if (skip) ++skip_depth;
+	for (u64 i = 0; i < buf_len(body); ++i) {
+		resolve_stmt(body[i]);
+	}
+	if (skip) --skip_depth;
+}
+
+/* expressions can nest far deeper than the C stack allows, so the
+ * expressions whose operands are being resolved are kept on 'frames'.
+ * every resolve_*_expr step gets the type of the operand it asked for
+ * last (nothing on the first call) and either hands out the next
+ * operand to resolve, or sets the frame's type and returns null. the
+ * steps run in the same order as a recursive walk would, so the
+ * diagnostics come out in the same order too. an expression is linked
+ * when it is handed out; once the linker fails, the rest is only
+ * linked and the type is null. */
+static DataType* resolve_expr(Expr* root) {
+	if (!RESOLVING) {
+		LINK(link_expr_tree(root));
+		return null;
+	}
+
+	u64 base = buf_len(frames);
+	Expr* next = root;
+	DataType* type = null;
+	for (;;) {
+		bool link_operands;
+		LINK(link_operands = link_expr(next));
+		if (link_failed) {
+			if (link_operands) {
+				ResolveFrame frame = { 0 };
+				frame.expr = next;
+				buf_push(frames, frame);
+			}
+			while (buf_len(frames) > base) pop_frame();
+			return null;
+		}
+
+		if (!has_operands(next)) {
+			type = resolve_leaf_expr(next);
+		}
+		else {
+			ResolveFrame frame = { 0 };
+			frame.expr = next;
+			buf_push(frames, frame);
+			ResolveFrame* f = &frames[buf_len(frames) - 1];
+			next = resolve_step(f, null);
+			if (next) continue;
+			type = f->type;
+			pop_frame();
+		}
+
+		/* hand the type up until an expression needs another operand */
+		next = null;
+		while (buf_len(frames) > base && !link_failed) {
+			ResolveFrame* f = &frames[buf_len(frames) - 1];
+			next = resolve_step(f, type);
+			if (next) break;
+			type = f->type;
+			pop_frame();
+		}
+		if (link_failed) {
+			while (buf_len(frames) > base) pop_frame();
+			return null;
+		}
+		if (!next) return type;
+	}
+}
+
+/* a call stops handing out arguments at the first one with an error,
+ * but the linker still has to see the rest */
+static void pop_frame(void) {
+	ResolveFrame* f = &frames[buf_len(frames) - 1];
+	if (f->expr->type == EXPR_DOT_ACCESS) {
+		if (f->next == 0) LINK(link_expr_tree(f->expr->dot.left));
+	}
+	else {
+		Expr** args = f->expr->func_call.args;
+		for (u64 i = f->next; i < buf_len(args); ++i) {
+			LINK(link_expr_tree(args[i]));
+		}
+	}
+	buf_pop(frames);
+}
+
+static bool has_operands(Expr* expr) {
+	switch (expr->type) {
+		case EXPR_NUMBER:
+		case EXPR_STRING:
+		case EXPR_CHAR:
+		case EXPR_NULL:
+		case EXPR_BOOL:
+		case EXPR_VARIABLE: return false;
+		default: return true;
+	}
+}
+
+static DataType* resolve_leaf_expr(Expr* expr) {
 	switch (expr->type) {
-		case EXPR_DOT_ACCESS:	return resolve_dot_access_expr(expr);
 		case EXPR_NUMBER:	 	return resolve_number_expr(expr);
 		case EXPR_STRING:	 	return string_data_type;
 		case EXPR_CHAR:		 	return char_data_type;
 		case EXPR_NULL:			return null_data_type;
 		case EXPR_BOOL:			return bool_data_type;	
 		case EXPR_VARIABLE:  	return resolve_variable_expr(expr);
-		case EXPR_FUNC_CALL: 	return resolve_func_call(expr);
+		default: break;
 	}
 	assert(0);
 	return null;
 }
 
-static DataType* resolve_dot_access_expr(Expr* expr) {
-	CHECK_ERROR;
-	DataType* left_type = resolve_expr(expr->dot.left);
-	EXIT_ERROR(null);
+static Expr* resolve_step(ResolveFrame* f, DataType* operand_type) {
+	switch (f->expr->type) {
+		case EXPR_DOT_ACCESS: return resolve_dot_access_expr(f, operand_type);
+		case EXPR_FUNC_CALL: return resolve_func_call(f, operand_type);
+		case EXPR_SET: return resolve_set_expr(f, operand_type);
+		case EXPR_DEREF: return resolve_deref_expr(f, operand_type);
+		case EXPR_ADDR: return resolve_addr_expr(f, operand_type);
+		case EXPR_AT: return resolve_at_expr(f, operand_type);
+		case EXPR_ARITHMETIC: return resolve_arithmetic_expr(f, operand_type);
+		case EXPR_COMPARISON: return resolve_comparison_expr(f, operand_type);
+		default: break;
+	}
+	assert(0);
+	return null;
+}
+
+static Expr* resolve_dot_access_expr(ResolveFrame* f, DataType* left_type) {
+	Expr* expr = f->expr;
+	if (f->next++ == 0) {
+		f->error_mark = error_count;
+		return expr->dot.left;
+	}
+	f->type = null;
+	if (error_count > f->error_mark) return null;
 
 	if (!left_type) return null;
 
@@ -312,12 +558,14 @@ static DataType* resolve_dot_access_expr(Expr* expr) {
 			left_type->pointer_count == 1) {
 			expr->dot.is_left_pointer = (left_type->pointer_count == 0 ?
 										 false : true);
-			Stmt* struct_ref = find_struct_by_name(left_type->type->lexeme);
+			Stmt* struct_ref = find_struct(left_type->type);
 			if (struct_ref) {
-				for (u64 f = 0; f < buf_len(struct_ref->struct_stmt.fields); ++f) {
-					if (is_token_identical(struct_ref->struct_stmt.fields[f]->identifier,
+				Field** fields = struct_ref->struct_stmt.fields;
+				for (u64 i = 0; i < buf_len(fields); ++i) {
+					if (is_token_identical(fields[i]->identifier,
 										   expr->dot.right)) {
-						return struct_ref->struct_stmt.fields[f]->type;
+						f->type = fields[i]->type;
+						return null;
 					}
 				}
 
@@ -338,20 +586,21 @@ static DataType* resolve_dot_access_expr(Expr* expr) {
 	return null;
 }
 
-static DataType* resolve_func_call(Expr* expr) {
-	if (expr->func_call.callee->type == TOKEN_IDENTIFIER &&
-		expr->func_call.function_called) {
+static Expr* resolve_func_call(ResolveFrame* f, DataType* arg_type) {
+	Expr* expr = f->expr;
+	if (expr->func_call.function_called) {
 		Stmt* function_called = expr->func_call.function_called;
 		Stmt** params = function_called->func.params;
 		Expr** args = expr->func_call.args;
 
-		bool did_error_occur = false;
-		for (u64 i = 0; i < buf_len(args); ++i) {
-			CHECK_ERROR;
-			DataType* param_type = params[i]->var_decl.type;
-			DataType* arg_type = resolve_expr(args[i]);
-			EXIT_ERROR(null);
+		if (f->next > 0) {
+			u64 i = f->next - 1;
+			if (error_count > f->error_mark) {
+				f->type = null;
+				return null;
+			}
 
+			DataType* param_type = params[i]->var_decl.type;
 			int match = data_type_match(param_type, arg_type);
 			if (match == DATA_TYPE_NOT_MATCH) {
 				error(args[i]->head,
@@ -362,7 +611,7 @@ static DataType* resolve_func_call(Expr* expr) {
 					 "function '%s' defined here: ",
 					 function_called->func.identifier->lexeme);
 				/* TODO: check if we have to return null here */
-				did_error_occur = true;
+				f->did_error_occur = true;
 			}
 			else if (match == DATA_TYPE_IMPLICIT_MATCH) {
 				implicit_cast_warning(args[i]->head,
@@ -370,59 +619,48 @@ static DataType* resolve_func_call(Expr* expr) {
 									  arg_type);
 			}
 		}
-		if (did_error_occur) {
-			/* TODO: check if we have to return null here */
-			return function_called->func.type;
-		}
-		return function_called->func.type;
-	}
-
-	else if (expr->func_call.callee->type == TOKEN_KEYWORD) {
-		if (str_intern(expr->func_call.callee->lexeme) ==
-			str_intern("set")) {
-			return resolve_set_expr(expr);
-		}
-		else if (str_intern(expr->func_call.callee->lexeme) ==
-				 str_intern("deref")) {
-			return resolve_deref_expr(expr);
-		}
-		else if (str_intern(expr->func_call.callee->lexeme) ==
-				 str_intern("addr")) {
-			return resolve_addr_expr(expr);
-		}
-		else if (str_intern(expr->func_call.callee->lexeme) ==
-				 str_intern("at")) {
-			return resolve_at_expr(expr);
-		}
-	}
-
-	else {
-		switch (expr->func_call.callee->type) {
-			case TOKEN_PLUS:
-			case TOKEN_MINUS:
-			case TOKEN_STAR:
-			case TOKEN_SLASH: 
-			case TOKEN_PERCENT:
-				return resolve_arithmetic_expr(expr); 
-
-			case TOKEN_EQUAL: 
-			case TOKEN_LESS:
-			case TOKEN_LESS_EQUAL:
-			case TOKEN_GREATER:
-			case TOKEN_GREATER_EQUAL: 
-				return resolve_comparison_expr(expr); 
-
-			default: return null;	
+		if (f->next < buf_len(args)) {
+			f->error_mark = error_count;
+			return args[f->next++];
 		}
+		/* TODO: check if we have to return null here if 'did_error_occur' */
+		f->type = function_called->func.type;
+		return null;
 	}
+	f->type = null;
 	return null;
 }
 
-static DataType* resolve_set_expr(Expr* expr) {
-	CHECK_ERROR;
-	DataType* var_type = resolve_expr(expr->func_call.args[0]);
-	DataType* expr_type = resolve_expr(expr->func_call.args[1]);
-	EXIT_ERROR(null);
+/* steps for operators with two operands: both are resolved before the
+ * error check, as in '[set a b]' */
+#define RESOLVE_BOTH_OPERANDS(f, operand_type) \
+	do { \
+		if ((f)->next == 0) { \
+			(f)->error_mark = error_count; \
+			return (f)->expr->func_call.args[(f)->next++]; \
+		} \
+		if ((f)->next == 1) { \
+			(f)->first_type = (operand_type); \
+			return (f)->expr->func_call.args[(f)->next++]; \
+		} \
+		(f)->type = null; \
+		if (error_count > (f)->error_mark) return null; \
+	} while (0)
+
+#define RESOLVE_ONE_OPERAND(f) \
+	do { \
+		if ((f)->next == 0) { \
+			(f)->error_mark = error_count; \
+			return (f)->expr->func_call.args[(f)->next++]; \
+		} \
+		(f)->type = null; \
+		if (error_count > (f)->error_mark) return null; \
+	} while (0)
+
+static Expr* resolve_set_expr(ResolveFrame* f, DataType* expr_type) {
+	RESOLVE_BOTH_OPERANDS(f, expr_type);
+	Expr* expr = f->expr;
+	DataType* var_type = f->first_type;
 
 	int match = data_type_match(var_type, expr_type);
 	if (match == DATA_TYPE_NOT_MATCH) {
@@ -437,46 +675,41 @@ static DataType* resolve_set_expr(Expr* expr) {
 							  expr_type,
 							  var_type);
 	}
-	return var_type;
+	f->type = var_type;
+	return null;
 }
 
-static DataType* resolve_deref_expr(Expr* expr) {
-	CHECK_ERROR;
-	DataType* type = resolve_expr(expr->func_call.args[0]);
-	EXIT_ERROR(null);
+static Expr* resolve_deref_expr(ResolveFrame* f, DataType* type) {
+	RESOLVE_ONE_OPERAND(f);
+	Expr* expr = f->expr;
 
 	if (type->pointer_count == 0) {
 		error(expr->func_call.args[0]->head,
 			  "cannot dereference a non-pointer type;");
 		return null;
 	}
-	else if	((str_intern(type->type->lexeme) == str_intern("void") &&
-		 type->pointer_count == 1)) {
+	else if	(type->type->keyword == KEYWORD_VOID &&
+			 type->pointer_count == 1) {
 		error(expr->func_call.args[0]->head,
 			  "cannot dereference a void-pointer; nameless type;");
 		return null;
 	}
 
-	DataType* dereferenced_type = clone_data_type(type);
-	dereferenced_type->pointer_count--;
-	return dereferenced_type;
+	f->type = intern_data_type(type->type, type->pointer_count - 1);
+	return null;
 }
 
-static DataType* resolve_addr_expr(Expr* expr) {
-	CHECK_ERROR;
-	DataType* type = resolve_expr(expr->func_call.args[0]);
-	EXIT_ERROR(null);
+static Expr* resolve_addr_expr(ResolveFrame* f, DataType* type) {
+	RESOLVE_ONE_OPERAND(f);
 
-	DataType* addressed_type = clone_data_type(type);
-	addressed_type->pointer_count++;
-	return addressed_type;
+	f->type = intern_data_type(type->type, type->pointer_count + 1);
+	return null;
 }
 
-static DataType* resolve_at_expr(Expr* expr) {
-	CHECK_ERROR;
-	DataType* var_type = resolve_expr(expr->func_call.args[0]);
-	DataType* expr_type = resolve_expr(expr->func_call.args[1]);
-	EXIT_ERROR(null);
+static Expr* resolve_at_expr(ResolveFrame* f, DataType* expr_type) {
+	RESOLVE_BOTH_OPERANDS(f, expr_type);
+	Expr* expr = f->expr;
+	DataType* var_type = f->first_type;
 
 	int match = data_type_match(int_data_type, expr_type);
 	if (match == DATA_TYPE_NOT_MATCH) {
@@ -491,17 +724,16 @@ static DataType* resolve_at_expr(Expr* expr) {
 							  int_data_type);
 	}
 
-	DataType* at_type = clone_data_type(var_type);
-	at_type->pointer_count--;
-	return at_type;
+	f->type = intern_data_type(var_type->type, var_type->pointer_count - 1);
+	return null;
 }
 
-static DataType* resolve_arithmetic_expr(Expr* expr) {
+static Expr* resolve_arithmetic_expr(ResolveFrame* f, DataType* arg_type) {
+	Expr* expr = f->expr;
 	Expr** args = expr->func_call.args;
 
-	bool did_error_occur = false;
-	for (u64 i = 0; i < buf_len(args); ++i) {
-		DataType* arg_type = resolve_expr(args[i]);
+	if (f->next > 0) {
+		u64 i = f->next - 1;
 		if (arg_type != null) {
 			/* TODO: if all args are of same integer type, then
 			 * no warnings are to be outputted */
@@ -513,23 +745,23 @@ static DataType* resolve_arithmetic_expr(Expr* expr) {
 					  expr->func_call.callee->lexeme,
 					  "int",
 					  data_type_to_string(arg_type));
-				did_error_occur = true;
+				f->did_error_occur = true;
 			}						
 		}
-		else did_error_occur = true;
+		else f->did_error_occur = true;
 	}
-	
-	if (did_error_occur) {
-		return null;
+	if (f->next < buf_len(args)) {
+		return args[f->next++];
 	}
-	return int_data_type;
+	
+	f->type = f->did_error_occur ? null : int_data_type;
+	return null;
 }
 
-static DataType* resolve_comparison_expr(Expr* expr) {
-	CHECK_ERROR;
-	DataType* a_expr_type = resolve_expr(expr->func_call.args[0]);
-	DataType* b_expr_type = resolve_expr(expr->func_call.args[1]);
-	EXIT_ERROR(null);
+static Expr* resolve_comparison_expr(ResolveFrame* f, DataType* b_expr_type) {
+	RESOLVE_BOTH_OPERANDS(f, b_expr_type);
+	Expr* expr = f->expr;
+	DataType* a_expr_type = f->first_type;
 
 	int match = data_type_match(a_expr_type, b_expr_type);
 	if (match == DATA_TYPE_NOT_MATCH) {
@@ -562,11 +794,14 @@ static DataType* resolve_comparison_expr(Expr* expr) {
 									 a_expr_type)));
 
 	}
-	return bool_data_type;
+	f->type = bool_data_type;
+	return null;
 }
 
+/* a 'for' counter has no type in the tree; code_gen makes it an 'int' */
 static DataType* resolve_variable_expr(Expr* expr) {
-	return expr->variable.variable_decl_referenced->var_decl.type;
+	DataType* type = expr->variable.variable_decl_referenced->var_decl.type;
+	return type ? type : int_data_type;
 }
 
 static DataType* resolve_number_expr(Expr* expr) {
@@ -574,45 +809,168 @@ static DataType* resolve_number_expr(Expr* expr) {
 	return int_data_type;	
 }
 
-static Stmt* find_struct_by_name(char* name) {
+/* null if 'name' is not a struct: the tree is resolved as it is
+ * linked, so a type can be used before the linker reaches the place
+ * where it turns out to be undefined */
+static Stmt* find_struct(Token* name) {
+	u64 idx = lookup_struct_index(name);
+	return idx ? structs[idx - 1] : null;
+}
+
+/* index + 1, 0 if 'name' is not a struct. types made by resolve itself
+ * can have symbols that are newer than the table, but those are never
+ * structs */
+static u64 lookup_struct_index(Token* name) {
+	if (name->symbol < symbol_count) {
+		return struct_indices[name->symbol];
+	}
+	return 0;
+}
+
+static void layout_structs(void) {
+	buf_fit(layouts, buf_len(structs));
 	for (u64 i = 0; i < buf_len(structs); ++i) {
-		if (str_intern(structs[i]->struct_stmt.identifier->lexeme) ==
-			str_intern(name)) {
-			return structs[i];
+		StructLayout layout = { 0 };
+		buf_push(layouts, layout);
+	}
+	for (u64 i = 0; i < buf_len(structs); ++i) {
+		layout_struct(i);
+	}
+}
+
+/* depth-first with an explicit stack: a struct stays on the stack
+ * until every struct it holds by value is laid out. one that is still
+ * on the stack when it is reached again contains itself. structs are
+ * laid out before the tree is linked, so a field can still be of an
+ * undefined type; the linker reports it and the field is skipped. */
+static void layout_struct(u64 root) {
+	if (layouts[root].state != LAYOUT_NONE) return;
+
+	buf_push(layout_stack, root);
+	while (buf_len(layout_stack) > 0) {
+		u64 idx = layout_stack[buf_len(layout_stack) - 1];
+		StructLayout* layout = &layouts[idx];
+		Field** fields = structs[idx]->struct_stmt.fields;
+		layout->state = LAYOUT_STARTED;
+
+		bool waiting = false;
+		for (; layout->next_field < buf_len(fields); ++layout->next_field) {
+			DataType* type = fields[layout->next_field]->type;
+			if (type->pointer_count != 0 ||
+				type->type->type != TOKEN_IDENTIFIER) {
+				continue;
+			}
+
+			u64 dep = lookup_struct_index(type->type);
+			if (!dep) continue;
+			--dep;
+
+			if (layouts[dep].state == LAYOUT_NONE) {
+				buf_push(layout_stack, dep);
+				waiting = true;
+				break;
+			}
+			else if (layouts[dep].state == LAYOUT_STARTED) {
+				error(type->type,
+					  "struct '%s' contains itself through field '%s';",
+					  type->type->lexeme,
+					  fields[layout->next_field]->identifier->lexeme);
+			}
 		}
+		if (waiting) continue;
+
+		finish_layout(idx);
+		buf_pop(layout_stack);
+	}
+}
+
+/* a field that makes a struct contain itself has already been
+ * reported and takes no space, as does one of an undefined type */
+static void finish_layout(u64 idx) {
+	StructLayout* layout = &layouts[idx];
+	Field** fields = structs[idx]->struct_stmt.fields;
+	u64 offset = 0;
+	u64 align = 1;
+
+	for (u64 i = 0; i < buf_len(fields); ++i) {
+		u64 field_size, field_align;
+		data_type_layout(fields[i]->type, &field_size, &field_align);
+		offset = (offset + field_align - 1) / field_align * field_align;
+		offset += field_size;
+		align = MAX(align, field_align);
+	}
+
+	layout->size = (offset + align - 1) / align * align;
+	layout->align = align;
+	layout->state = LAYOUT_DONE;
+}
+
+static void data_type_layout(DataType* type, u64* out_size, u64* out_align) {
+	*out_size = 0;
+	*out_align = 1;
+	if (type->pointer_count > 0) {
+		*out_size = sizeof(void*);
+		*out_align = sizeof(void*);
+	}
+	else if (type->type->type == TOKEN_IDENTIFIER) {
+		u64 idx = lookup_struct_index(type->type);
+		if (idx && layouts[idx - 1].state == LAYOUT_DONE) {
+			*out_size = layouts[idx - 1].size;
+			*out_align = layouts[idx - 1].align;
+		}
+	}
+	else {
+		assert(type->type->keyword >= KEYWORD_INT &&
+			   type->type->keyword <= KEYWORD_VOID);
+		*out_size = builtin_type_sizes[type->type->keyword - KEYWORD_INT];
+		*out_align = CLAMP_MIN(*out_size, 1);
 	}
-	assert(0);
-	return null;
 }
 
 static DataType* make_data_type(const char* main_type, u8 pointer_count) {
-	DataType* type = (DataType*)malloc(sizeof(DataType));
-	type->type = make_token_from_string(main_type);
-	type->pointer_count = pointer_count;
-	/* TODO: ??? push type into buf to free it later */
-	return type;
-}
-
-static DataType* clone_data_type(DataType* p_type) {
-	DataType* type = (DataType*)malloc(sizeof(DataType));
-	type->type = p_type->type;
-	type->pointer_count = p_type->pointer_count;
-	buf_push(cloned_data_types, type);
-	return type;	
-}
-
-static Token* make_token_from_string(const char* str) {
-	Token* t = (Token*)malloc(sizeof(Token));
-	t->type = TOKEN_KEYWORD; /* TODO: does it need to be KEYWORD? */
-	t->lexeme = (char*)str_intern((char*)str);
-	t->line = 0;
-	t->column = 0;
-	/* TODO: ??? push type into buf to free it later */
+	Token t = make_token_from_string(main_type);
+	return intern_data_type(&t, pointer_count);
+}
+
+/* the canonical type keeps a copy of the first 'main_type' token it
+ * was made from */
+static DataType* intern_data_type(Token* main_type, u8 pointer_count) {
+	u64 key = ((u64)main_type->symbol << 8) | pointer_count;
+	CanonicalType* canonical = (CanonicalType*)map_get(&canonical_types, key);
+	if (canonical) return &canonical->type;
+
+	canonical = (CanonicalType*)arena_alloc(&type_arena, sizeof(CanonicalType));
+	canonical->main_type = *main_type;
+	canonical->type.type = &canonical->main_type;
+	canonical->type.pointer_count = pointer_count;
+
+	u64 main_type_len = strlen(main_type->lexeme);
+	canonical->name = (char*)arena_alloc(&type_arena, main_type_len + pointer_count + 1);
+	memcpy(canonical->name, main_type->lexeme, main_type_len);
+	memset(canonical->name + main_type_len, '*', pointer_count);
+	canonical->name[main_type_len + pointer_count] = '\0';
+
+	map_put(&canonical_types, key, (u64)canonical);
+	return &canonical->type;
+}
+
+static Token make_token_from_string(const char* str) {
+	Token t;
+	t.type = TOKEN_KEYWORD; /* TODO: does it need to be KEYWORD? */
+	t.keyword = lookup_keyword((char*)str, strlen(str));
+	t.lexeme = (char*)str_intern((char*)str);
+	t.symbol = str_symbol(t.lexeme);
+	t.srcfile = null;
+	t.line = 0;
+	t.column = 0;
 	return t;
 }
 
 static int data_type_match(DataType* a, DataType* b) {
 	if (a && b) {
+		if (a == b) {
+			return DATA_TYPE_MATCH;
+		}
 		if (a->pointer_count != b->pointer_count) {
 			return DATA_TYPE_NOT_MATCH;
 		}
@@ -635,81 +993,33 @@ static int data_type_match(DataType* a, DataType* b) {
 			// }
 
 			/* implicit non-pointer cast */
-			if (can_implicit_cast(a->type->lexeme, b->type->lexeme)) {
+			if (can_implicit_cast(a->type, b->type)) {
 				return DATA_TYPE_IMPLICIT_MATCH;
 			}
-			buf_free(types_already_checked);
-			buf_clear(types_already_checked);
-			types_already_checked = null;
 		}
 	}
 	return DATA_TYPE_NOT_MATCH;
 }
 
-static bool can_implicit_cast(char* a, char* b) {
-	for (u64 i = 0; i < buf_len(implicit_cast_types); ++i) {
-		bool first_elem_match = (str_intern(implicit_cast_types[i].a) == str_intern(a));
-		bool second_elem_match = (str_intern(implicit_cast_types[i].b) == str_intern(a));
-
-		if (first_elem_match) {
-			if (str_intern(implicit_cast_types[i].b) ==
-				str_intern(b)) {
-				return true;
-			}
-			if (!is_type_already_checked_for_cast(implicit_cast_types[i].b)) {
-				buf_push(types_already_checked, implicit_cast_types[i].b);
-				return can_implicit_cast(implicit_cast_types[i].a, b);
-			}
-			continue;
-		}
-		else if (second_elem_match) {
-			if (str_intern(implicit_cast_types[i].a) ==
-				str_intern(b)) {
-				return true;
-			}
-			if (!is_type_already_checked_for_cast(implicit_cast_types[i].a)) {
-				buf_push(types_already_checked, implicit_cast_types[i].a);
-				return can_implicit_cast(implicit_cast_types[i].a, b);
-			}
-			continue;
-		}
+static bool can_implicit_cast(Token* a, Token* b) {
+	if (a->type != TOKEN_KEYWORD || b->type != TOKEN_KEYWORD ||
+		a->keyword < KEYWORD_INT || a->keyword > KEYWORD_VOID ||
+		b->keyword < KEYWORD_INT || b->keyword > KEYWORD_VOID) {
+		return false;
 	}
-	return false;
-}
-
-static bool is_type_already_checked_for_cast(char* type) {
-	for (u64 i = 0; i < buf_len(types_already_checked); ++i) {
-		if (str_intern(type) ==
-			str_intern(types_already_checked[i])) {
-			return true;
-		}
-	}
-	return false;
+	return (implicit_casts[a->keyword - KEYWORD_INT] >>
+			(b->keyword - KEYWORD_INT)) & 1;
 }
 
 static bool is_one_token(const char* equal, Token* a, Token* b) {
-	if (str_intern(a->lexeme) == str_intern((char*)equal)) {
-		return true;
-	}
-	if (str_intern(b->lexeme) == str_intern((char*)equal)) {
-		return true;
-	}
-	return false;
+	u32 symbol = symbol_of((char*)equal);
+	return a->symbol == symbol || b->symbol == symbol;
 }
 
 static char* data_type_to_string(DataType* type) {
-	/* TODO: this is highly inefficient; use maps */
-	u64 main_type_len = strlen(type->type->lexeme);
-	u64 len = main_type_len + type->pointer_count;
-	char* str = (char*)malloc(len + 1);
-
-	strncpy(str, type->type->lexeme, main_type_len);
-	for (u64 i = main_type_len; i < len; ++i) {
-		str[i] = '*';
-	}
-	str[len] = '\0';
-	buf_push(data_type_strings, str);
-	return str;
+	CanonicalType* canonical =
+		(CanonicalType*)intern_data_type(type->type, type->pointer_count);
+	return canonical->name;
 }
 
 static DataType* get_smaller_type(DataType* a, DataType* b) {
@@ -723,28 +1033,9 @@ static DataType* get_smaller_type(DataType* a, DataType* b) {
 }
 
 static u64 get_data_type_size(DataType* type) {
-	if (type->pointer_count > 0) {
-		return sizeof(void*);
-	}
-	else {
-		for (u64 i = 0; i < buf_len(type_sizes); ++i) {
-			if (str_intern(type->type->lexeme) ==
-				str_intern(type_sizes[i].type)) {
-				return type_sizes[i].size;
-			}
-		}
-		if (type->type->type == TOKEN_IDENTIFIER) {
-			u64 total_count = 0;
-			Stmt* struct_ref = find_struct_by_name(type->type->lexeme);
-			assert(struct_ref);
-			for (u64 i = 0; i < buf_len(struct_ref->struct_stmt.fields); ++i) {
-				total_count +=
-					get_data_type_size(struct_ref->struct_stmt.fields[i]->type);
-			}
-			return total_count;
-		}
-		assert(0);
-	}
+	u64 size, align;
+	data_type_layout(type, &size, &align);
+	return size;
 }
 
 static void implicit_cast_warning(Token* error_token,
@@ -761,50 +1052,30 @@ static void init_data_types(void) {
 	string_data_type = make_data_type("char", 1);
 	bool_data_type = make_data_type("bool", 0);
 	null_data_type = make_data_type("void", 1);
+	init_implicit_casts();
+}
 
-	buf_push(implicit_cast_types, 
-		(ImplicitCastTypeMap){ str_intern("int"), str_intern("char") });
-
-	buf_push(implicit_cast_types, 
-		(ImplicitCastTypeMap){ str_intern("int"), str_intern("i8") });
-	buf_push(implicit_cast_types, 
-		(ImplicitCastTypeMap){ str_intern("int"), str_intern("i16") });
-	buf_push(implicit_cast_types, 
-		(ImplicitCastTypeMap){ str_intern("int"), str_intern("132") });
-	buf_push(implicit_cast_types, 
-		(ImplicitCastTypeMap){ str_intern("int"), str_intern("i64") });
-
-	buf_push(implicit_cast_types, 
-		(ImplicitCastTypeMap){ str_intern("int"), str_intern("u8") });
-	buf_push(implicit_cast_types, 
-		(ImplicitCastTypeMap){ str_intern("int"), str_intern("u16") });
-	buf_push(implicit_cast_types, 
-		(ImplicitCastTypeMap){ str_intern("int"), str_intern("u32") });
-	buf_push(implicit_cast_types, 
-		(ImplicitCastTypeMap){ str_intern("int"), str_intern("u64") });
-
-	buf_push(type_sizes,
-		(TypeSizeMap){ str_intern("int"), sizeof(int) });
-	buf_push(type_sizes,
-		(TypeSizeMap){ str_intern("char"), sizeof(char) });
-	buf_push(type_sizes,
-		(TypeSizeMap){ str_intern("bool"), sizeof(u8) });
-
-	buf_push(type_sizes,
-		(TypeSizeMap){ str_intern("i8"), sizeof(i8) });
-	buf_push(type_sizes,
-		(TypeSizeMap){ str_intern("i16"), sizeof(i16) });
-	buf_push(type_sizes,
-		(TypeSizeMap){ str_intern("i32"), sizeof(i32) });
-	buf_push(type_sizes,
-		(TypeSizeMap){ str_intern("i64"), sizeof(i64) });
-
-	buf_push(type_sizes,
-		(TypeSizeMap){ str_intern("u8"), sizeof(u8) });
-	buf_push(type_sizes,
-		(TypeSizeMap){ str_intern("u16"), sizeof(u16) });
-	buf_push(type_sizes,
-		(TypeSizeMap){ str_intern("u32"), sizeof(u32) });
-	buf_push(type_sizes,
-		(TypeSizeMap){ str_intern("u64"), sizeof(u64) });
+static u32 symbol_of(char* str) {
+	return str_symbol(str_intern(str));
+}
+
+static void init_implicit_casts(void) {
+	assert(BUILTIN_TYPE_COUNT <= 32);
+	memset(implicit_casts, 0, sizeof(implicit_casts));
+	for (u64 i = 0; i < sizeof(direct_implicit_casts) /
+			 sizeof(direct_implicit_casts[0]); ++i) {
+		uint a = direct_implicit_casts[i].a - KEYWORD_INT;
+		uint b = direct_implicit_casts[i].b - KEYWORD_INT;
+		implicit_casts[a] |= 1u << b;
+		implicit_casts[b] |= 1u << a;
+	}
+
+	/* warshall: after step k, chains through the first k types are in */
+	for (uint k = 0; k < BUILTIN_TYPE_COUNT; ++k) {
+		for (uint i = 0; i < BUILTIN_TYPE_COUNT; ++i) {
+			if (implicit_casts[i] & (1u << k)) {
+				implicit_casts[i] |= implicit_casts[k];
+			}
+		}
+	}
 }
@@ -0,0 +1,51 @@
+#include <ether/ether.h>
+
+/* character-class scanners used by the lexer. every scanner takes
+ * [cur, end) and returns a pointer to the first byte that does not
+ * belong to the run, or 'end'. a chunk lexer's 'end' is in the middle
+ * of the file, so none of them may look past it. */
+
+static bool is_identifier_char(char);
+
+/* spaces, tabs and carriage returns; newlines are left to the caller
+ * since it has to keep track of lines */
+char* scan_whitespace(char* cur, char* end) {
+	while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\r')) {
+		++cur;
+	}
+	return cur;
+}
+
+/* [A-Za-z0-9_] */
+char* scan_identifier(char* cur, char* end) {
+	while (cur < end && is_identifier_char(*cur)) {
+		++cur;
+	}
+	return cur;
+}
+
+/* first '\n' or '\0' */
+char* scan_line_end(char* cur, char* end) {
+	while (cur < end && *cur != '\n' && *cur != '\0') {
+		++cur;
+	}
+	return cur;
+}
+
+/* first '"' or '\0' */
+char* scan_string_end(char* cur, char* end) {
+	while (cur < end && *cur != '"' && *cur != '\0') {
+		++cur;
+	}
+	return cur;
+}
+
+/* plain ASCII ranges, the same set the lexer starts identifiers with;
+ * isalnum would depend on the locale and is undefined for the negative
+ * chars of non-ASCII bytes */
+static bool is_identifier_char(char c) {
+	return (c >= 'a' && c <= 'z') ||
+		   (c >= 'A' && c <= 'Z') ||
+		   (c >= '0' && c <= '9') ||
+		   c == '_';
+}
@@ -1,23 +1,151 @@
 #include <ether/ether.h>
+#include <pthread.h>
 
-static Intern* interns;
+#define INTERN_SHARD_COUNT 16
+#define INTERN_TABLE_MIN_CAP 1024
+#define INTERN_ARENA_BLOCK_SIZE (64 * 1024)
+#define INTERN_CACHE_SIZE 256
+
+/* the interner is split into shards picked by hash so that lexer
+ * threads rarely wait on each other. every shard is an open-addressing
+ * (linear probing) table; the strings themselves live in an
+ * append-only arena so that interned pointers never move. every string
+ * is numbered as it is first interned, and the number is stored right
+ * in front of it, so str_symbol() needs no lookup. */
+typedef struct {
+	pthread_mutex_t lock;
+	Intern* table;
+	u64 table_cap;
+	u64 table_len;
+
+	char* arena_ptr;
+	char* arena_end;
+} InternShard;
+
+static InternShard shards[INTERN_SHARD_COUNT];
+static pthread_once_t shards_once = PTHREAD_ONCE_INIT;
+static u32 symbol_count = 1; /* 0 is no symbol */
+
+/* per-thread, direct-mapped cache in front of the shards. since an
+ * interned string never changes, a hit needs no locking; it takes
+ * the frequent identifiers and all punctuation off the shared locks. */
+static __thread Intern cache[INTERN_CACHE_SIZE];
+
+static void init_shards(void);
+static u64 hash_range(char*, u64);
+static void grow_table(InternShard*);
+static char* arena_push(InternShard*, char*, u64);
 
 char* str_intern_range(char* start, char* end) {
 	u64 len = end - start;
-	for (u64 i = 0; i < buf_len(interns); ++i) {
-		if (interns[i].len == len &&
-			strncmp(interns[i].str, start, len) == false) {
-			return interns[i].str;
+	u64 hash = hash_range(start, len);
+
+	Intern* cached = &cache[hash & (INTERN_CACHE_SIZE - 1)];
+	if (cached->str && cached->hash == hash && cached->len == len &&
+		memcmp(cached->str, start, len) == 0) {
+		return cached->str;
+	}
+
+	pthread_once(&shards_once, init_shards);
+	/* the low bits pick the table slot, so use high bits for the shard */
+	InternShard* shard = &shards[(hash >> 59) & (INTERN_SHARD_COUNT - 1)];
+	pthread_mutex_lock(&shard->lock);
+
+	if (shard->table_len * 2 >= shard->table_cap) {
+		grow_table(shard);
+	}
+
+	char* str = null;
+	u64 i = hash & (shard->table_cap - 1);
+	for (;;) {
+		Intern* slot = &shard->table[i];
+		if (!slot->str) {
+			slot->len = len;
+			slot->hash = hash;
+			slot->str = arena_push(shard, start, len);
+			++shard->table_len;
+			str = slot->str;
+			break;
+		}
+		if (slot->hash == hash && slot->len == len &&
+			memcmp(slot->str, start, len) == 0) {
+			str = slot->str;
+			break;
 		}
+		i = (i + 1) & (shard->table_cap - 1);
 	}
 
-	char* str = (char*)malloc(len + 1);
-	memcpy(str, start, len);
-	str[len] = 0;
-	buf_push(interns, (Intern){ len, str });
+	pthread_mutex_unlock(&shard->lock);
+
+	cached->len = len;
+	cached->hash = hash;
+	cached->str = str;
 	return str;
 }
 
 char* str_intern(char* str) {
 	return str_intern_range(str, str + strlen(str));
 }
+
+u32 str_symbol(char* interned) {
+	u32 symbol;
+	memcpy(&symbol, interned - sizeof(u32), sizeof(u32));
+	return symbol;
+}
+
+u32 str_symbol_count(void) {
+	return __atomic_load_n(&symbol_count, __ATOMIC_ACQUIRE);
+}
+
+static void init_shards(void) {
+	for (u64 i = 0; i < INTERN_SHARD_COUNT; ++i) {
+		pthread_mutex_init(&shards[i].lock, null);
+	}
+}
+
+/* FNV-1a */
+static u64 hash_range(char* start, u64 len) {
+	u64 hash = 0xcbf29ce484222325ull;
+	for (u64 i = 0; i < len; ++i) {
+		hash ^= (uchar)start[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static void grow_table(InternShard* shard) {
+	u64 new_cap = CLAMP_MIN(shard->table_cap * 2, INTERN_TABLE_MIN_CAP);
+	Intern* new_table = (Intern*)calloc(new_cap, sizeof(Intern));
+	assert(new_table);
+
+	for (u64 i = 0; i < shard->table_cap; ++i) {
+		if (!shard->table[i].str) continue;
+		u64 j = shard->table[i].hash & (new_cap - 1);
+		while (new_table[j].str) {
+			j = (j + 1) & (new_cap - 1);
+		}
+		new_table[j] = shard->table[i];
+	}
+
+	free(shard->table);
+	shard->table = new_table;
+	shard->table_cap = new_cap;
+}
+
+static char* arena_push(InternShard* shard, char* start, u64 len) {
+	u64 size = sizeof(u32) + len + 1;
+	if ((u64)(shard->arena_end - shard->arena_ptr) < size) {
+		u64 block_size = MAX(size, INTERN_ARENA_BLOCK_SIZE);
+		shard->arena_ptr = (char*)malloc(block_size);
+		assert(shard->arena_ptr);
+		shard->arena_end = shard->arena_ptr + block_size;
+	}
+
+	u32 symbol = __atomic_fetch_add(&symbol_count, 1, __ATOMIC_RELEASE);
+	memcpy(shard->arena_ptr, &symbol, sizeof(u32));
+	char* str = shard->arena_ptr + sizeof(u32);
+	memcpy(str, start, len);
+	str[len] = '\0';
+	shard->arena_ptr += size;
+	return str;
+}
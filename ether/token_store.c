@@ -0,0 +1,89 @@
+#include <ether/ether.h>
+
+#define TOKEN_STORE_MIN_CAP 256
+
+static void token_store_grow(TokenStore*, u64);
+
+void token_store_push(TokenStore* store, TokenType type, KeywordType keyword,
+					  char* lexeme, u64 offset) {
+	if (store->len == store->cap) {
+		token_store_grow(store, store->len + 1);
+	}
+
+	u64 i = store->len++;
+	store->types[i] = type;
+	store->keywords[i] = keyword;
+	store->lexemes[i] = lexeme;
+	store->offsets[i] = offset;
+}
+
+/* the full record of token 'idx', with its line and column worked out
+ * from its offset through the line index of 'file'. EOF is put at the
+ * end of the last line, on the final newline if there is one. */
+Token token_store_get(TokenStore* store, SourceFile* file, u64 idx) {
+	u64 line = 0;
+	return token_store_get_from(store, file, idx, &line);
+}
+
+/* the same, with the line search starting from '*io_line' (see
+ * get_position_from) */
+Token token_store_get_from(TokenStore* store, SourceFile* file, u64 idx,
+						   u64* io_line) {
+	assert(idx < store->len);
+	Token t;
+	t.type = store->types[idx];
+	t.keyword = store->keywords[idx];
+	t.lexeme = store->lexemes[idx];
+	t.symbol = (t.type == TOKEN_EOF ? 0 : str_symbol(t.lexeme));
+	t.srcfile = file;
+
+	u64 offset = store->offsets[idx];
+	if (t.type == TOKEN_EOF && offset > 0 &&
+		file->contents[offset - 1] == '\n') {
+		--offset;
+	}
+	get_position_from(file, offset, io_line, &t.column);
+	t.line = *io_line;
+	return t;
+}
+
+void token_store_free(TokenStore* store) {
+	/* 'lexemes' is the start of the single block */
+	free(store->lexemes);
+	store->types = null;
+	store->keywords = null;
+	store->lexemes = null;
+	store->offsets = null;
+	store->len = 0;
+	store->cap = 0;
+}
+
+/* the arrays are laid out in order of decreasing alignment:
+ * lexemes, offsets, types, keywords */
+static void token_store_grow(TokenStore* store, u64 min_cap) {
+	u64 new_cap = CLAMP_MIN(store->cap * 2, TOKEN_STORE_MIN_CAP);
+	new_cap = CLAMP_MIN(new_cap, min_cap);
+	u64 elem_size = sizeof(char*) + sizeof(u64) +
+					sizeof(TokenType) + sizeof(KeywordType);
+	char* block = (char*)malloc(new_cap * elem_size);
+	assert(block);
+
+	char** lexemes = (char**)block;
+	u64* offsets = (u64*)(lexemes + new_cap);
+	TokenType* types = (TokenType*)(offsets + new_cap);
+	KeywordType* keywords = (KeywordType*)(types + new_cap);
+
+	if (store->len) {
+		memcpy(lexemes, store->lexemes, store->len * sizeof(char*));
+		memcpy(offsets, store->offsets, store->len * sizeof(u64));
+		memcpy(types, store->types, store->len * sizeof(TokenType));
+		memcpy(keywords, store->keywords, store->len * sizeof(KeywordType));
+	}
+	free(store->lexemes);
+
+	store->lexemes = lexemes;
+	store->offsets = offsets;
+	store->types = types;
+	store->keywords = keywords;
+	store->cap = new_cap;
+}
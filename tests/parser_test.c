@@ -0,0 +1,77 @@
+#include <ether/ether.h>
+
+/* parses a generated file that is big enough to be split into chunks,
+ * once on one thread and once on four, and checks that every function
+ * is at the same, physical line either way. every function holds a
+ * multi-line string, so there is always one in front of a split.
+ * usage: parser_test */
+
+#define FUNC_COUNT 8000
+
+static char* make_input(u64*, u64*);
+static bool check_lines(SourceFile*, uint, u64*);
+
+int main(void) {
+	u64 expected_lines[FUNC_COUNT];
+	SourceFile file;
+	file.fpath = "parser_test.eth";
+	file.contents = make_input(&file.len, expected_lines);
+	file.map_len = 0;
+	file.line_offsets = null;
+
+	bool ok = check_lines(&file, 1, expected_lines);
+	ok = check_lines(&file, 4, expected_lines) && ok;
+
+	buf_free(file.line_offsets);
+	buf_free(file.contents);
+	printf("parser_test: %s\n", ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+static char* make_input(u64* out_len, u64* out_lines) {
+	char* contents = null;
+	u64 line = 1;
+	for (u64 i = 0; i < FUNC_COUNT; ++i) {
+		out_lines[i] = line;
+		buf_printf(contents,
+				   "[defn int:f%lu [int:a]\n"
+				   "\t[let char*:s \"first line\n"
+				   "second line\n"
+				   "third line\"]\n"
+				   "\t[return a]]\n"
+				   "\n", i);
+		line += 6;
+	}
+	/* buf_printf leaves the terminating '\0' right behind the text */
+	*out_len = buf_len(contents);
+	return contents;
+}
+
+static bool check_lines(SourceFile* file, uint threads, u64* expected_lines) {
+	parser_set_thread_count(threads);
+
+	Parser parser;
+	Lexer lexer;
+	Arena arena = { 0 };
+	error_code err = ETHER_SUCCESS;
+	Stmt** stmts = parser_run(&parser, &lexer, &arena, file, &err);
+
+	bool ok = true;
+	if (err || buf_len(stmts) != FUNC_COUNT) {
+		printf("%u thread(s): parse failed (%lu functions)\n",
+			   threads, buf_len(stmts));
+		ok = false;
+	}
+	for (u64 i = 0; ok && i < FUNC_COUNT; ++i) {
+		Token* name = stmts[i]->func.identifier;
+		if (name->line != expected_lines[i]) {
+			printf("%u thread(s): %s at line %lu, expected %lu\n",
+				   threads, name->lexeme, name->line, expected_lines[i]);
+			ok = false;
+		}
+	}
+
+	buf_free(parser.loads);
+	arena_free(&arena);
+	return ok;
+}
@@ -0,0 +1,172 @@
+#define _POSIX_C_SOURCE 200809L
+#include <ether/ether.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* applies random edits to random sources and checks that lexer_relex
+ * gives exactly the tokens a full lex of the edited file gives, and
+ * that everything outside the TokenRange it reports was taken over
+ * from the old tokens unchanged. each edit is made on top of the
+ * previous one, starting from the relexed tokens.
+ * diagnostics go to stdout, which is sent to /dev/null while lexing.
+ * usage: relex_test [iterations] */
+
+#define EDITS_PER_FILE 6
+
+static const char* fragments[] = {
+	"[", "]", "[defn int:main [void]", "[let int:x 10]", "\n", "\n", "\n",
+	" ", "\t", "abc", "x1", "42", "3.14", "+", "<=", ">", ":", ".",
+	";; comment\n", "\"str\"", "\"multi\nline\nstring\"", "'c'", "'\n'",
+	"\"", "'", ";", "\r", "return", "if", "struct", "#",
+};
+
+static u64 rng_state = 0x2545f4914f6cdd1d;
+static int out_fd;
+
+static u64 rng(void);
+static u64 rng_below(u64);
+static char* random_text(u64);
+static SourceFile* new_file(char*, u64);
+static bool lex_failed(Lexer*, TokenStore*);
+static bool check_relex(TokenStore*, TokenStore*, TokenStore*,
+						SourceEdit*, TokenRange*);
+
+int main(int argc, char** argv) {
+	u64 iterations = argc > 1 ? strtoull(argv[1], null, 10) : 2000;
+	out_fd = dup(STDOUT_FILENO);
+	int null_fd = open("/dev/null", O_WRONLY);
+	dup2(null_fd, STDOUT_FILENO);
+	close(null_fd);
+
+	u64 checked = 0;
+	u64 failed = 0;
+	for (u64 i = 0; i < iterations && failed == 0; ++i) {
+		char* text = random_text(rng_below(40));
+		SourceFile* file = new_file(text, buf_len(text));
+		buf_free(text);
+
+		Lexer lexer;
+		TokenStore tokens = *lexer_run(&lexer, file, null);
+		if (lex_failed(&lexer, &tokens)) {
+			token_store_free(&tokens);
+			ether_close_file(file);
+			continue;
+		}
+
+		for (u64 e = 0; e < EDITS_PER_FILE; ++e) {
+			SourceEdit edit;
+			edit.offset = rng_below(file->len + 1);
+			edit.removed_len = rng_below(MIN(file->len - edit.offset, 12) + 1);
+			char* inserted = random_text(rng_below(4));
+			edit.inserted = inserted ? inserted : "";
+			edit.inserted_len = buf_len(inserted);
+			SourceFile* edited = source_file_apply_edit(file, &edit);
+
+			Lexer full_lexer;
+			TokenStore full = *lexer_run(&full_lexer, edited, null);
+			bool skip = lex_failed(&full_lexer, &full);
+
+			Lexer relexer;
+			TokenRange changed;
+			TokenStore relexed = tokens;
+			if (!skip) {
+				relexed = *lexer_relex(&relexer, edited, &tokens,
+									   &edit, &changed, null);
+				++checked;
+				if (!check_relex(&tokens, &relexed, &full, &edit, &changed)) {
+					dprintf(out_fd, "relex_test: edit %lu of file %lu "
+							"(offset %lu, removed %lu, inserted '%s') "
+							"differs from a full lex\n",
+							e, i, edit.offset, edit.removed_len, edit.inserted);
+					++failed;
+				}
+			}
+
+			token_store_free(&full);
+			buf_free(inserted);
+			if (skip || failed) {
+				ether_close_file(edited);
+				break;
+			}
+			token_store_free(&tokens);
+			tokens = relexed;
+			ether_close_file(file);
+			file = edited;
+		}
+
+		token_store_free(&tokens);
+		ether_close_file(file);
+	}
+
+	dprintf(out_fd, "relex_test: %s (%lu edits checked)\n",
+			failed ? "FAILED" : "ok", checked);
+	return failed ? 1 : 0;
+}
+
+/* xorshift64, so that every run checks the same edits */
+static u64 rng(void) {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+static u64 rng_below(u64 n) {
+	return n == 0 ? 0 : rng() % n;
+}
+
+static char* random_text(u64 fragment_count) {
+	char* text = null;
+	u64 fragment_kinds = sizeof(fragments) / sizeof(fragments[0]);
+	for (u64 i = 0; i < fragment_count; ++i) {
+		buf_printf(text, "%s", fragments[rng_below(fragment_kinds)]);
+	}
+	return text;
+}
+
+static SourceFile* new_file(char* text, u64 len) {
+	SourceFile empty = { "relex_test.eth", "", 0, 0, null };
+	SourceEdit edit = { 0, 0, text ? text : "", len };
+	return source_file_apply_edit(&empty, &edit);
+}
+
+/* lexer_run gives up without an EOF token once it hits the error
+ * limit; there is nothing to relex from then */
+static bool lex_failed(Lexer* lexer, TokenStore* tokens) {
+	return lexer->error_count > LEXER_ERROR_COUNT_MAX ||
+		   tokens->len == 0 ||
+		   tokens->types[tokens->len - 1] != TOKEN_EOF;
+}
+
+static bool same_token(TokenStore* a, u64 i, TokenStore* b, u64 j, i64 shift) {
+	return a->types[i] == b->types[j] &&
+		   a->keywords[i] == b->keywords[j] &&
+		   a->lexemes[i] == b->lexemes[j] &&
+		   (i64)a->offsets[i] + shift == (i64)b->offsets[j];
+}
+
+static bool check_relex(TokenStore* old, TokenStore* relexed, TokenStore* full,
+						SourceEdit* edit, TokenRange* changed) {
+	if (relexed->len != full->len) return false;
+	for (u64 i = 0; i < full->len; ++i) {
+		if (!same_token(relexed, i, full, i, 0)) return false;
+	}
+
+	if (changed->first + changed->old_count > old->len ||
+		changed->first + changed->new_count > relexed->len ||
+		old->len - changed->old_count != relexed->len - changed->new_count) {
+		return false;
+	}
+	for (u64 i = 0; i < changed->first; ++i) {
+		if (!same_token(old, i, relexed, i, 0)) return false;
+	}
+	i64 shift = (i64)edit->inserted_len - (i64)edit->removed_len;
+	u64 old_rest = changed->first + changed->old_count;
+	u64 new_rest = changed->first + changed->new_count;
+	for (u64 k = 0; old_rest + k < old->len; ++k) {
+		if (!same_token(old, old_rest + k, relexed, new_rest + k, shift)) {
+			return false;
+		}
+	}
+	return true;
+}